@@ -7,6 +7,7 @@
 #include "devices/shutdown.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/workqueue.h"
 
 /* Keyboard data register port. */
 #define DATA_REG 0x60
@@ -24,12 +25,24 @@ static bool caps_lock;
 /* Number of keys pressed. */
 static int64_t key_cnt;
 
+/* Scancodes received by the interrupt handler and not yet
+   interpreted.  Accessed only with interrupts off. */
+#define SCANCODE_CNT 64
+static unsigned scancodes[SCANCODE_CNT];
+static unsigned scancode_head, scancode_tail;
+
+/* Work item that interprets the received scancodes. */
+static struct work kbd_work;
+
 static intr_handler_func keyboard_interrupt;
+static work_func interpret_scancodes;
+static void interpret_scancode (unsigned code);
 
 /* Initializes the keyboard. */
 void
 kbd_init (void) 
 {
+  work_init (&kbd_work, interpret_scancodes, NULL);
   intr_register_ext (0x21, keyboard_interrupt, "8042 Keyboard");
 }
 
@@ -94,25 +107,59 @@ static bool map_key (const struct keymap[], unsigned scancode, uint8_t *);
 
 static void
 keyboard_interrupt (struct intr_frame *args UNUSED) 
+{
+  /* Keyboard scancode. */
+  unsigned code;
+
+  /* Read scancode, including second byte if prefix code. */
+  code = inb (DATA_REG);
+  if (code == 0xe0)
+    code = (code << 8) | inb (DATA_REG);
+
+  /* Leave the rest to a worker thread.  If it has fallen so far
+     behind that the buffer is full, drop the key. */
+  if (scancode_head - scancode_tail < SCANCODE_CNT)
+    {
+      scancodes[scancode_head++ % SCANCODE_CNT] = code;
+      work_queue (&kbd_work, WORK_HIGH);
+    }
+}
+
+/* Interprets the scancodes received by keyboard_interrupt(), in
+   a worker thread. */
+static void
+interpret_scancodes (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      bool empty = scancode_tail == scancode_head;
+      unsigned code = empty ? 0 : scancodes[scancode_tail++ % SCANCODE_CNT];
+      intr_set_level (old_level);
+
+      if (empty)
+        break;
+      interpret_scancode (code);
+    }
+}
+
+/* Updates the shift state or appends a character to the input
+   buffer according to scancode CODE. */
+static void
+interpret_scancode (unsigned code)
 {
   /* Status of shift keys. */
   bool shift = left_shift || right_shift;
   bool alt = left_alt || right_alt;
   bool ctrl = left_ctrl || right_ctrl;
 
-  /* Keyboard scancode. */
-  unsigned code;
-
   /* False if key pressed, true if key released. */
   bool release;
 
   /* Character that corresponds to `code'. */
   uint8_t c;
 
-  /* Read scancode, including second byte if prefix code. */
-  code = inb (DATA_REG);
-  if (code == 0xe0)
-    code = (code << 8) | inb (DATA_REG);
+  enum intr_level old_level;
 
   /* Bit 0x80 distinguishes key press from key release
      (even if there's a prefix). */
@@ -154,11 +201,13 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
             c += 0x80;
 
           /* Append to keyboard buffer. */
+          old_level = intr_disable ();
           if (!input_full ())
             {
               key_cnt++;
               input_putc (c);
             }
+          intr_set_level (old_level);
         }
     }
   else
@@ -11,15 +11,13 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
      - Channel 0 is connected to interrupt line 0, so that it can
-       be used as a periodic timer interrupt, as implemented in
-       Pintos in devices/timer.c.
+       be used as a periodic timer interrupt, or as a one-shot
+       timer (see pit_start_oneshot()) as implemented in Pintos
+       in devices/timer.c.
 
      - Channel 1 is used for dynamic RAM refresh (in older PCs).
        No good can come of messing with this.
@@ -81,3 +79,54 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts a one-shot countdown of COUNT PIT cycles on CHANNEL,
+   using mode 0 ("interrupt on terminal count"): the channel's
+   output goes low now and rises when the count reaches zero, at
+   which point channel 0 raises its interrupt.  The counter then
+   keeps counting down, wrapping around from 0 to 65535, but the
+   output stays high until the channel is programmed again.
+
+   Only channel 0 may be used this way, since channel 2 drives
+   the speaker.  COUNT must be nonzero. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0);
+  ASSERT (count != 0);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current value of CHANNEL's counter.  If EXPIRED is
+   non-null, sets *EXPIRED to the state of the channel's output,
+   which for a one-shot countdown started by pit_start_oneshot()
+   is true once the countdown has reached zero.
+
+   Uses the 8254 read-back command, which latches the count and
+   the status byte at the same instant. */
+uint16_t
+pit_read_count (int channel, bool *expired)
+{
+  enum intr_level old_level;
+  uint8_t status, lo, hi;
+
+  ASSERT (channel >= 0 && channel <= 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xc0 | (1 << (channel + 1)));
+  status = inb (PIT_PORT_COUNTER (channel));
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  if (expired != NULL)
+    *expired = (status & 0x80) != 0;
+  return (hi << 8) | lo;
+}
@@ -20,11 +20,63 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* The PIT runs in one-shot mode.  Each timer interrupt advances
+   `ticks' by however many tick boundaries have passed and then
+   programs the next interrupt for the earliest of the next tick
+   boundary and the earliest sub-tick sleeper's deadline.  While
+   the CPU is idle, tick boundaries with nothing to do are
+   skipped, up to the longest countdown the PIT supports.
+
+   Time is measured in PIT cycles since boot.  CLOCK_BASE is the
+   time at which the current countdown of CLOCK_COUNT cycles was
+   started. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define CLOCK_MIN_CYCLES 20             /* Shortest countdown. */
+#define CLOCK_MAX_CYCLES 65535          /* Longest countdown. */
+static int64_t clock_base;
+static uint16_t clock_count;
+static int64_t tick_deadline;   /* Time at which `ticks' next advances. */
+static bool clock_idle;         /* Skipping ticks while idle? */
+static int64_t timer_interrupts;        /* # of timer interrupts. */
+
+/* Sleeps shorter than this many PIT cycles busy-wait, because
+   blocking would cost more than the sleep itself. */
+#define HIRES_MIN_CYCLES (PIT_HZ / 20000)
+
+/* A thread blocked in a sub-tick sleep. */
+struct hires_sleeper
+  {
+    struct list_elem elem;              /* Element in hires_list. */
+    int64_t deadline;                   /* Time to wake, in PIT cycles. */
+    struct thread *thread;              /* Sleeping thread. */
+  };
+
+/* Sub-tick sleepers, ordered by deadline. */
+static struct list hires_list;
+
+/* Pending kernel timers, hashed by expiry tick into a timer
+   wheel.  Bucket I holds every pending timer whose expiry tick
+   is congruent to I modulo TIMER_WHEEL_SIZE, in no particular
+   order.  Each tick the interrupt handler visits only the
+   current bucket, so the cost per tick is the number of timers
+   that expire plus the few that merely share the bucket with
+   them, independent of the total number of sleepers. */
+#define TIMER_WHEEL_SIZE 128
+static struct list timer_wheel[TIMER_WHEEL_SIZE];
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static void timer_wheel_run (void);
+static void wake_sleeper (void *thread_);
+static int64_t clock_now (void);
+static void clock_program (void);
+static int64_t next_deadline (void);
+static void hires_sleep (int64_t cycles);
+static bool hires_less (const struct list_elem *, const struct list_elem *,
+                        void *aux);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -35,7 +87,16 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
-  pit_configure_channel (0, 2, TIMER_FREQ);
+  size_t i;
+
+  for (i = 0; i < TIMER_WHEEL_SIZE; i++)
+    list_init (&timer_wheel[i]);
+  list_init (&hires_list);
+
+  clock_base = 0;
+  clock_count = TICK_CYCLES;
+  tick_deadline = TICK_CYCLES;
+  pit_start_oneshot (0, clock_count);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -76,6 +137,25 @@ timer_ticks (void)
   return t;
 }
 
+/* Returns the time since the OS booted in PIT cycles, of which
+   there are PIT_HZ per second.  Finer-grained but more expensive
+   than timer_ticks(). */
+int64_t
+timer_cycles (void)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t t = clock_now ();
+  intr_set_level (old_level);
+  return t;
+}
+
+/* Converts CYCLES, a duration in PIT cycles, to microseconds. */
+int64_t
+timer_cycles_to_us (int64_t cycles)
+{
+  return cycles * 1000 * 1000 / PIT_HZ;
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 int64_t
@@ -85,15 +165,23 @@ timer_elapsed (int64_t then)
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.  The calling thread is blocked, not merely
+   yielding, until a kernel timer wakes it. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct timer_event wakeup;
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  timer_event_init (&wakeup, wake_sleeper, thread_current ());
+  old_level = intr_disable ();
+  timer_event_schedule (&wakeup, ticks);
+  thread_block ();
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -159,19 +247,267 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Initializes kernel timer EVENT to call CALLBACK with argument
+   AUX when it fires.  The timer is not scheduled. */
+void
+timer_event_init (struct timer_event *event, timer_callback_func *callback,
+                  void *aux)
+{
+  ASSERT (event != NULL);
+  ASSERT (callback != NULL);
+
+  event->expires = 0;
+  event->callback = callback;
+  event->aux = aux;
+  event->pending = false;
+}
+
+/* Schedules EVENT, which must not already be pending, to fire
+   after DELAY timer ticks.  A DELAY of zero or less fires the
+   timer at the next tick.
+
+   This function may be called from an interrupt handler. */
+void
+timer_event_schedule (struct timer_event *event, int64_t delay)
+{
+  enum intr_level old_level;
+
+  ASSERT (event != NULL);
+  ASSERT (!event->pending);
+
+  old_level = intr_disable ();
+  event->expires = ticks + (delay > 0 ? delay : 1);
+  event->pending = true;
+  list_push_back (&timer_wheel[event->expires % TIMER_WHEEL_SIZE],
+                  &event->elem);
+  if (clock_idle)
+    clock_program ();
+  intr_set_level (old_level);
+}
+
+/* Cancels EVENT if it is pending.  Returns true if EVENT was
+   pending, false if it had already fired or was never
+   scheduled.
+
+   This function may be called from an interrupt handler. */
+bool
+timer_event_cancel (struct timer_event *event)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (event != NULL);
+
+  old_level = intr_disable ();
+  was_pending = event->pending;
+  if (was_pending)
+    {
+      list_remove (&event->elem);
+      event->pending = false;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" interrupts\n",
+          timer_ticks (), timer_interrupts);
+}
+
+/* Called by the idle thread, with interrupts off, just before
+   it halts the CPU.  Lets the timer skip tick boundaries until
+   the next kernel timer or sub-tick sleeper is due. */
+void
+timer_idle_enter (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  clock_idle = true;
+  clock_program ();
+}
+
+/* Called by the scheduler, with interrupts off, when it switches
+   away from the idle thread.  Resumes regular ticks.  Ticks
+   skipped while idle are accounted for by the next timer
+   interrupt, which is due no later than the next tick
+   boundary. */
+void
+timer_idle_exit (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (clock_idle)
+    {
+      clock_idle = false;
+      clock_program ();
+    }
 }
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
+{
+  int64_t now = clock_now ();
+  bool user = (args->cs & 3) == 3;
+
+  timer_interrupts++;
+  while (now >= tick_deadline)
+    {
+      ticks++;
+      tick_deadline += TICK_CYCLES;
+      timer_wheel_run ();
+      thread_tick (user);
+    }
+
+  while (!list_empty (&hires_list))
+    {
+      struct hires_sleeper *s = list_entry (list_front (&hires_list),
+                                            struct hires_sleeper, elem);
+      if (s->deadline > now)
+        break;
+      list_pop_front (&hires_list);
+      thread_unblock (s->thread);
+      thread_preempt ();
+    }
+
+  clock_program ();
+}
+
+/* Returns the current time, in PIT cycles since boot.  Must be
+   called with interrupts off. */
+static int64_t
+clock_now (void)
+{
+  bool expired;
+  uint16_t count = pit_read_count (0, &expired);
+
+  /* After the countdown expires, the counter wraps around to
+     65535 and keeps counting down. */
+  if (!expired)
+    return clock_base + (clock_count - count);
+  else
+    return clock_base + clock_count + ((0x10000 - count) & 0xffff);
+}
+
+/* Returns the time, in PIT cycles, at which the next timer
+   interrupt is needed. */
+static int64_t
+next_deadline (void)
+{
+  int64_t deadline = tick_deadline;
+
+  if (clock_idle)
+    {
+      /* Skip ahead to the first tick with a kernel timer due, as
+         far as one countdown can reach. */
+      int64_t t;
+
+      for (t = ticks + 1; deadline - clock_base < CLOCK_MAX_CYCLES; t++)
+        {
+          struct list *bucket = &timer_wheel[t % TIMER_WHEEL_SIZE];
+          struct list_elem *e;
+
+          for (e = list_begin (bucket); e != list_end (bucket);
+               e = list_next (e))
+            if (list_entry (e, struct timer_event, elem)->expires <= t)
+              break;
+          if (e != list_end (bucket))
+            break;
+          deadline += TICK_CYCLES;
+        }
+    }
+
+  if (!list_empty (&hires_list))
+    {
+      struct hires_sleeper *s = list_entry (list_front (&hires_list),
+                                            struct hires_sleeper, elem);
+      if (s->deadline < deadline)
+        deadline = s->deadline;
+    }
+  return deadline;
+}
+
+/* Programs the PIT to interrupt at next_deadline(), or as close
+   to it as the PIT can manage.  Must be called with interrupts
+   off. */
+static void
+clock_program (void)
+{
+  int64_t delta;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  clock_base = clock_now ();
+  delta = next_deadline () - clock_base;
+  if (delta < CLOCK_MIN_CYCLES)
+    delta = CLOCK_MIN_CYCLES;
+  else if (delta > CLOCK_MAX_CYCLES)
+    delta = CLOCK_MAX_CYCLES;
+  clock_count = delta;
+  pit_start_oneshot (0, clock_count);
+}
+
+/* Blocks the current thread for CYCLES PIT cycles, which is
+   normally less than one tick. */
+static void
+hires_sleep (int64_t cycles)
+{
+  struct hires_sleeper s;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  s.deadline = clock_now () + cycles;
+  s.thread = thread_current ();
+  list_insert_ordered (&hires_list, &s.elem, hires_less, NULL);
+  if (list_front (&hires_list) == &s.elem)
+    clock_program ();
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Returns true if sub-tick sleeper A_ is due before B_. */
+static bool
+hires_less (const struct list_elem *a_, const struct list_elem *b_,
+            void *aux UNUSED)
+{
+  const struct hires_sleeper *a = list_entry (a_, struct hires_sleeper, elem);
+  const struct hires_sleeper *b = list_entry (b_, struct hires_sleeper, elem);
+
+  return a->deadline < b->deadline;
+}
+
+/* Fires every kernel timer that expires at the current tick.
+   Runs in the timer interrupt handler. */
+static void
+timer_wheel_run (void)
+{
+  struct list *bucket = &timer_wheel[ticks % TIMER_WHEEL_SIZE];
+  struct list_elem *e = list_begin (bucket);
+
+  while (e != list_end (bucket))
+    {
+      struct timer_event *event = list_entry (e, struct timer_event, elem);
+
+      e = list_next (e);
+      if (event->expires <= ticks)
+        {
+          list_remove (&event->elem);
+          event->pending = false;
+          event->callback (event->aux);
+        }
+    }
+}
+
+/* Timer callback used by timer_sleep() to wake THREAD_. */
+static void
+wake_sleeper (void *thread_)
 {
-  ticks++;
-  thread_tick ();
+  thread_unblock (thread_);
+  thread_preempt ();
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -229,9 +565,15 @@ real_time_sleep (int64_t num, int32_t denom)
     }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      /* Otherwise, block until a one-shot timer interrupt at the
+         exact deadline, unless the sleep is so short that a
+         busy-wait is cheaper. */
+      int64_t cycles = num * PIT_HZ / denom;
+
+      if (cycles >= HIRES_MIN_CYCLES)
+        hires_sleep (cycles);
+      else
+        real_time_delay (num, denom); 
     }
 }
 
@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,6 +14,8 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_cycles (void);
+int64_t timer_cycles_to_us (int64_t cycles);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -26,4 +30,31 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless idle. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+/* Kernel timers.
+
+   A kernel timer calls a function, in the timer interrupt
+   handler, once a given number of ticks has elapsed.  Because
+   the callback runs in an external interrupt context, it must
+   not sleep.  The `struct timer_event' is owned by the caller
+   and must stay valid until it fires or is cancelled. */
+typedef void timer_callback_func (void *aux);
+
+struct timer_event
+  {
+    struct list_elem elem;              /* Timer wheel bucket element. */
+    int64_t expires;                    /* Tick at which to fire. */
+    timer_callback_func *callback;      /* Function to call. */
+    void *aux;                          /* Argument to CALLBACK. */
+    bool pending;                       /* Scheduled and not yet fired? */
+  };
+
+void timer_event_init (struct timer_event *, timer_callback_func *,
+                       void *aux);
+void timer_event_schedule (struct timer_event *, int64_t delay);
+bool timer_event_cancel (struct timer_event *);
+
 #endif /* devices/timer.h */
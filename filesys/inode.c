@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* Define number of direct, indirect and doubly indirect blocks per inode */
 #define NUM_DIRECT 4
@@ -125,11 +126,15 @@ static block_sector_t byte_to_sector (const struct inode *inode, off_t pos) {
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of in-memory inodes. */
+static struct kmem_cache *inode_cache;
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -204,7 +209,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -265,7 +270,7 @@ void inode_close (struct inode *inode) {
         } else {
             // TODO: write inode back to disk
         }
-        free (inode);  
+        kmem_cache_free (inode_cache, inode);  
     }
 }
 
@@ -27,6 +27,7 @@ typedef unsigned long elem_type;
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
+    size_t next_fit;    /* Where bitmap_scan_and_flip_next() resumes. */
     elem_type *bits;    /* Elements that represent bits. */
   };
 
@@ -60,6 +61,35 @@ byte_cnt (size_t bit_cnt)
   return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/* Returns an elem_type with the CNT bits starting at bit OFS
+   turned on.  OFS + CNT must not exceed ELEM_BITS. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt)
+{
+  elem_type mask = (cnt < ELEM_BITS
+                    ? ((elem_type) 1 << cnt) - 1 : (elem_type) -1);
+  return mask << ofs;
+}
+
+/* Returns element IDX of B, inverted if VALUE is false, so that
+   the bits set to VALUE are the ones that read as 1. */
+static inline elem_type
+elem_for (const struct bitmap *b, size_t idx, bool value)
+{
+  return value ? b->bits[idx] : ~b->bits[idx];
+}
+
+/* Returns the number of bits set in X. */
+static inline size_t
+count_ones (elem_type x)
+{
+  size_t cnt = 0;
+
+  for (; x != 0; x &= x - 1)
+    cnt++;
+  return cnt;
+}
+
 /* Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -82,6 +112,7 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->next_fit = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -104,6 +135,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
   ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
   b->bit_cnt = bit_cnt;
+  b->next_fit = 0;
   b->bits = (elem_type *) (b + 1);
   bitmap_set_all (b, false);
   return b;
@@ -213,18 +245,29 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Works a whole element at a time.  Unlike bitmap_set(), this
+   is not atomic. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+      elem_type mask = range_mask (ofs, n);
+
+      if (value)
+        b->bits[elem_idx (start)] |= mask;
+      else
+        b->bits[elem_idx (start)] &= ~mask;
+      start += n;
+      cnt -= n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,34 +275,62 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+
+      value_cnt += count_ones (elem_for (b, elem_idx (start), value)
+                               & range_mask (ofs, n));
+      start += n;
+      cnt -= n;
+    }
   return value_cnt;
 }
 
+/* Returns the index of the first bit in B at or after START, and
+   before END, that is set to VALUE, or END if there is none.
+   Skips over a whole element at a time. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  size_t idx;
+  elem_type bits;
+
+  if (start >= end)
+    return end;
+
+  idx = elem_idx (start);
+  bits = elem_for (b, idx, value) & ~(bit_mask (start) - 1);
+  while (bits == 0)
+    {
+      if (++idx * ELEM_BITS >= end)
+        return end;
+      bits = elem_for (b, idx, value);
+    }
+
+  /* BSF finds the lowest set bit.  See [IA32-v2a]. */
+  start = idx * ELEM_BITS + __builtin_ctzl (bits);
+  return start < end ? start : end;
+}
+
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return find_next (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -288,6 +359,42 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B that are all set to VALUE and lie at or
+   after START and before END.  If there is no such group,
+   returns BITMAP_ERROR.
+
+   Each step finds the next bit set to VALUE, then the next bit
+   after it that is not.  If the run between them is too short,
+   the search resumes past its end, so no bit is looked at more
+   than twice. */
+static size_t
+scan_range (const struct bitmap *b, size_t start, size_t end, size_t cnt,
+            bool value)
+{
+  size_t last;
+
+  if (cnt > end || start > end - cnt)
+    return BITMAP_ERROR;
+  if (cnt == 0)
+    return start;
+
+  last = end - cnt;
+  while (start <= last)
+    {
+      size_t run_end;
+
+      start = find_next (b, start, last + 1, value);
+      if (start > last || cnt == 1)
+        break;
+      run_end = find_next (b, start, start + cnt, !value);
+      if (run_end == start + cnt)
+        return start;
+      start = run_end;
+    }
+  return start <= last ? start : BITMAP_ERROR;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -298,15 +405,7 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
-    }
-  return BITMAP_ERROR;
+  return scan_range (b, start, b->bit_cnt, cnt, value);
 }
 
 /* Finds the first group of CNT consecutive bits in B at or after
@@ -324,6 +423,34 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Like bitmap_scan_and_flip(), but instead of starting from a
+   fixed index, resumes just past the group found by the previous
+   call, wrapping around to the beginning of B if necessary
+   ("next fit").  Successive calls then do not rescan the groups
+   already flipped at the front of B. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t idx;
+
+  ASSERT (b != NULL);
+
+  idx = scan_range (b, b->next_fit, b->bit_cnt, cnt, value);
+  if (idx == BITMAP_ERROR && b->next_fit > 0)
+    {
+      /* Wrap around.  A group may straddle the old cursor. */
+      size_t end = b->next_fit + cnt - 1;
+      idx = scan_range (b, 0, end < b->bit_cnt ? end : b->bit_cnt,
+                        cnt, value);
+    }
+  if (idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (b, idx, cnt, !value);
+      b->next_fit = idx + cnt < b->bit_cnt ? idx + cnt : 0;
+    }
+  return idx;
+}
 
 /* File input and output. */
 
@@ -0,0 +1,21 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+/* Resource usage of a process, as reported by the rusage system
+   call. */
+struct rusage
+  {
+    long long user_ticks;               /* Timer ticks in user mode. */
+    long long kernel_ticks;             /* Timer ticks in the kernel. */
+    unsigned voluntary_switches;        /* Switches on block or yield. */
+    unsigned involuntary_switches;      /* Switches on preemption. */
+    unsigned page_faults;               /* Page faults. */
+  };
+
+/* Special PID arguments to rusage().  Any other PID must be that
+   of a child of the caller that has exited, whether or not it
+   has been waited for. */
+#define RUSAGE_SELF 0                   /* The calling process. */
+#define RUSAGE_CHILDREN -1              /* Its waited-for children. */
+
+#endif /* lib/rusage.h */
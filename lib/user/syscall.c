@@ -182,3 +182,9 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+rusage (pid_t pid, struct rusage *usage)
+{
+  return syscall2 (SYS_RUSAGE, pid, usage);
+}
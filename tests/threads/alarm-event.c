@@ -0,0 +1,79 @@
+/* Tests kernel timers: checks that timer events fire in order of
+   their expiration times, no earlier than requested, including an
+   event that shares a timer wheel bucket with an earlier one, and
+   that a cancelled event does not fire. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define EVENT_CNT 4
+
+/* One kernel timer under test. */
+struct event_info
+  {
+    struct timer_event event;   /* The timer. */
+    int64_t delay;              /* Requested delay, in ticks. */
+    int64_t fired;              /* Tick at which it fired, or 0. */
+  };
+
+static timer_callback_func event_fired;
+
+static struct event_info events[EVENT_CNT];
+static int order[EVENT_CNT];
+static int fired_cnt;
+static struct semaphore done;
+
+void
+test_alarm_event (void) 
+{
+  /* Delays 10 and 138 are 128 ticks apart, so they land in the
+     same bucket of the timer wheel.  Event 3 is cancelled. */
+  static const int64_t delays[EVENT_CNT] = {30, 10, 138, 20};
+  int64_t start;
+  int i;
+
+  sema_init (&done, 0);
+  start = timer_ticks ();
+  for (i = 0; i < EVENT_CNT; i++)
+    {
+      events[i].delay = delays[i];
+      events[i].fired = 0;
+      timer_event_init (&events[i].event, event_fired, &events[i]);
+      timer_event_schedule (&events[i].event, delays[i]);
+    }
+  msg ("Cancelling event 3: %s.",
+       timer_event_cancel (&events[3].event) ? "was pending" : "FAILED");
+
+  /* Event 2 fires last. */
+  sema_down (&done);
+
+  msg ("%d events fired.", fired_cnt);
+  for (i = 0; i < fired_cnt; i++)
+    {
+      struct event_info *e = &events[order[i]];
+      msg ("Event %d fired after %lld ticks.", order[i], e->delay);
+      if (e->fired - start < e->delay)
+        fail ("event %d fired %lld ticks after start, before its delay",
+              order[i], e->fired - start);
+    }
+  msg ("Cancelling event 2 after it fired: %s.",
+       timer_event_cancel (&events[2].event) ? "FAILED" : "was not pending");
+}
+
+/* Timer callback.  Runs in the timer interrupt handler, so it only
+   records when it ran and leaves the printing to the test. */
+static void
+event_fired (void *info_) 
+{
+  struct event_info *info = info_;
+
+  info->fired = timer_ticks ();
+  if (fired_cnt < EVENT_CNT)
+    order[fired_cnt] = info - events;
+  fired_cnt++;
+  if (info == &events[2])
+    sema_up (&done);
+}
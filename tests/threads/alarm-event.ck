@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-event) begin
+(alarm-event) Cancelling event 3: was pending.
+(alarm-event) 3 events fired.
+(alarm-event) Event 1 fired after 10 ticks.
+(alarm-event) Event 0 fired after 30 ticks.
+(alarm-event) Event 2 fired after 138 ticks.
+(alarm-event) Cancelling event 2 after it fired: was not pending.
+(alarm-event) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Tests that any number of threads can hold a readers-writer
+   lock for reading at once, and that a writer cannot get it
+   while any of them does. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread;
+static struct rwlock rwlock;
+static struct semaphore done;
+static int readers_in;
+
+void
+test_rwlock_readers (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock, false);
+  sema_init (&done, 0);
+
+  rwlock_acquire_read (&rwlock);
+  readers_in = 1;
+  msg ("Main thread acquired the lock for reading.");
+  for (i = 0; i < 3; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT + 1, reader_thread, NULL);
+    }
+  msg ("%d threads are reading.", readers_in);
+  msg ("Write lock %s.", rwlock_try_acquire_write (&rwlock)
+       ? "acquired, but it should not have been" : "not available");
+  rwlock_release_read (&rwlock);
+  readers_in--;
+
+  for (i = 0; i < 3; i++)
+    sema_up (&done);
+  msg ("Write lock %s.", rwlock_try_acquire_write (&rwlock)
+       ? "acquired" : "not available, but it should have been");
+  rwlock_release_write (&rwlock);
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_read (&rwlock);
+  readers_in++;
+  msg ("Thread %s acquired the lock for reading.", thread_name ());
+  sema_down (&done);
+  readers_in--;
+  msg ("Thread %s releasing the lock.", thread_name ());
+  rwlock_release_read (&rwlock);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) Main thread acquired the lock for reading.
+(rwlock-readers) Thread reader 0 acquired the lock for reading.
+(rwlock-readers) Thread reader 1 acquired the lock for reading.
+(rwlock-readers) Thread reader 2 acquired the lock for reading.
+(rwlock-readers) 4 threads are reading.
+(rwlock-readers) Write lock not available.
+(rwlock-readers) Thread reader 0 releasing the lock.
+(rwlock-readers) Thread reader 1 releasing the lock.
+(rwlock-readers) Thread reader 2 releasing the lock.
+(rwlock-readers) Write lock acquired.
+(rwlock-readers) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Tests that a thread holding a readers-writer lock for writing
+   excludes both readers and other writers, and that a waiting
+   writer is preferred over readers that arrive after it, even
+   while the lock is held only for reading. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread;
+static thread_func reader_thread;
+static struct rwlock rwlock;
+
+void
+test_rwlock_writer (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock, false);
+
+  /* Writer exclusion. */
+  rwlock_acquire_write (&rwlock);
+  msg ("Main thread acquired the lock for writing.");
+  thread_create ("reader 1", PRI_DEFAULT + 1, reader_thread, NULL);
+  thread_create ("writer 1", PRI_DEFAULT + 1, writer_thread, NULL);
+  msg ("Read lock %s.", rwlock_try_acquire_read (&rwlock)
+       ? "acquired, but it should not have been" : "not available");
+  msg ("Main thread releasing the lock.");
+  rwlock_release_write (&rwlock);
+
+  /* Writer preference. */
+  rwlock_acquire_read (&rwlock);
+  msg ("Main thread acquired the lock for reading.");
+  thread_create ("writer 2", PRI_DEFAULT + 1, writer_thread, NULL);
+  thread_create ("reader 2", PRI_DEFAULT + 2, reader_thread, NULL);
+  msg ("Main thread releasing the lock.");
+  rwlock_release_read (&rwlock);
+  msg ("Main thread done.");
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  msg ("Thread %s waiting to write.", thread_name ());
+  rwlock_acquire_write (&rwlock);
+  msg ("Thread %s acquired the lock for writing.", thread_name ());
+  msg ("Thread %s releasing the lock.", thread_name ());
+  rwlock_release_write (&rwlock);
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  msg ("Thread %s waiting to read.", thread_name ());
+  rwlock_acquire_read (&rwlock);
+  msg ("Thread %s acquired the lock for reading.", thread_name ());
+  msg ("Thread %s releasing the lock.", thread_name ());
+  rwlock_release_read (&rwlock);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer) begin
+(rwlock-writer) Main thread acquired the lock for writing.
+(rwlock-writer) Thread reader 1 waiting to read.
+(rwlock-writer) Thread writer 1 waiting to write.
+(rwlock-writer) Read lock not available.
+(rwlock-writer) Main thread releasing the lock.
+(rwlock-writer) Thread writer 1 acquired the lock for writing.
+(rwlock-writer) Thread writer 1 releasing the lock.
+(rwlock-writer) Thread reader 1 acquired the lock for reading.
+(rwlock-writer) Thread reader 1 releasing the lock.
+(rwlock-writer) Main thread acquired the lock for reading.
+(rwlock-writer) Thread writer 2 waiting to write.
+(rwlock-writer) Thread reader 2 waiting to read.
+(rwlock-writer) Main thread releasing the lock.
+(rwlock-writer) Thread writer 2 acquired the lock for writing.
+(rwlock-writer) Thread writer 2 releasing the lock.
+(rwlock-writer) Thread reader 2 acquired the lock for reading.
+(rwlock-writer) Thread reader 2 releasing the lock.
+(rwlock-writer) Main thread done.
+(rwlock-writer) end
+EOF
+pass;
@@ -0,0 +1,90 @@
+/* Tests slab caches: allocates enough objects to fill several
+   slabs, checks that they are aligned, constructed and do not
+   overlap, and that freed objects are reused and keep their
+   constructed state. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 200
+#define OBJ_MAGIC 0x0b1ec7ed
+
+/* An object with a constructed state. */
+struct object
+  {
+    unsigned magic;             /* Set by the constructor. */
+    int data[25];               /* Filled in by the test. */
+  };
+
+static kmem_ctor_func construct;
+
+static struct object *objs[OBJ_CNT];
+
+void
+test_slab_cache (void) 
+{
+  struct kmem_cache *c, *small;
+  void *p, *q;
+  int i, j;
+
+  c = kmem_cache_create ("test", sizeof (struct object), construct);
+  if (c == NULL)
+    fail ("kmem_cache_create() failed");
+
+  msg ("Allocating %d objects.", OBJ_CNT);
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = kmem_cache_alloc (c);
+      if (objs[i] == NULL)
+        fail ("allocation %d failed", i);
+      if ((uintptr_t) objs[i] % 8 != 0)
+        fail ("object %d at %p is misaligned", i, objs[i]);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %d was not constructed", i);
+      for (j = 0; j < 25; j++)
+        objs[i]->data[j] = i;
+    }
+
+  msg ("Checking that no objects overlap.");
+  for (i = 0; i < OBJ_CNT; i++)
+    for (j = 0; j < 25; j++)
+      if (objs[i]->data[j] != i)
+        fail ("object %d was overwritten", i);
+
+  msg ("Freeing and reallocating.");
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (c, objs[i]);
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = kmem_cache_alloc (c);
+      if (objs[i] == NULL)
+        fail ("reallocation %d failed", i);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %d lost its constructed state", i);
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (c, objs[i]);
+
+  msg ("Reusing a freed object without a constructor.");
+  small = kmem_cache_create ("test-small", 12, NULL);
+  if (small == NULL)
+    fail ("kmem_cache_create() failed");
+  p = kmem_cache_alloc (small);
+  memset (p, 0xcc, 12);
+  kmem_cache_free (small, p);
+  q = kmem_cache_alloc (small);
+  if (q != p)
+    fail ("freed object %p not reused, got %p", p, q);
+  kmem_cache_free (small, q);
+}
+
+/* Constructor for struct object. */
+static void
+construct (void *obj_) 
+{
+  struct object *obj = obj_;
+  obj->magic = OBJ_MAGIC;
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Allocating 200 objects.
+(slab-cache) Checking that no objects overlap.
+(slab-cache) Freeing and reallocating.
+(slab-cache) Reusing a freed object without a constructor.
+(slab-cache) end
+EOF
+pass;
@@ -0,0 +1,127 @@
+/* Tests vmalloc(): checks that allocations lie in the vmalloc
+   region, are zeroed on request, usable across all of their
+   pages and separated by guard pages, and that malloc() falls
+   back to vmalloc() for a big block when physical memory is too
+   fragmented to supply contiguous pages. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+#define PAGE_CNT 3
+
+static void *take_all (enum palloc_flags, void *pages);
+static void check_pages (uint8_t *, size_t page_cnt, const char *name);
+static void check_apart (uint8_t *, uint8_t *, size_t page_cnt);
+
+void
+test_vmalloc (void) 
+{
+  uint8_t *a, *b, *big;
+  void *kept, *pages, *p, *next;
+  size_t i;
+
+  msg ("Allocating two %d-page areas.", PAGE_CNT);
+  a = vmalloc (PAL_ZERO, PAGE_CNT);
+  b = vmalloc (PAL_ZERO, PAGE_CNT);
+  if (a == NULL || b == NULL)
+    fail ("vmalloc() failed");
+  for (i = 0; i < PAGE_CNT * PGSIZE; i++)
+    if (a[i] != 0 || b[i] != 0)
+      fail ("byte %zu not zeroed", i);
+  check_pages (a, PAGE_CNT, "a");
+  check_pages (b, PAGE_CNT, "b");
+  check_apart (a, b, PAGE_CNT);
+  check_apart (b, a, PAGE_CNT);
+  vfree (a, PAGE_CNT);
+  vfree (b, PAGE_CNT);
+
+  /* Take every page the kernel can get, including those it
+     borrows from the user pool, and then every page left in the
+     user pool.  Give back only those with even page numbers, so
+     that no two free pages are adjacent in either pool. */
+  msg ("Fragmenting the page pools.");
+  pages = take_all (0, NULL);
+  pages = take_all (PAL_USER, pages);
+  kept = NULL;
+  for (p = pages; p != NULL; p = next)
+    {
+      next = *(void **) p;
+      if (pg_no (p) % 2 == 0)
+        palloc_free_page (p);
+      else
+        {
+          *(void **) p = kept;
+          kept = p;
+        }
+    }
+
+  p = palloc_get_multiple (0, 2);
+  if (p != NULL)
+    fail ("got 2 contiguous pages at %p after fragmenting", p);
+
+  msg ("Allocating a big block with malloc().");
+  big = malloc (PAGE_CNT * PGSIZE);
+  if (big == NULL)
+    fail ("malloc() failed");
+  if (!is_vmalloc_vaddr (big))
+    fail ("big block %p not from vmalloc()", big);
+  memset (big, 0x5a, PAGE_CNT * PGSIZE);
+  for (i = 0; i < PAGE_CNT * PGSIZE; i++)
+    if (big[i] != 0x5a)
+      fail ("big block byte %zu is corrupt", i);
+  free (big);
+
+  for (p = kept; p != NULL; p = next)
+    {
+      next = *(void **) p;
+      palloc_free_page (p);
+    }
+}
+
+/* Allocates pages with FLAGS until none are left, linking each
+   page to the next through its first word, starting from the
+   list PAGES.  Returns the new head of the list. */
+static void *
+take_all (enum palloc_flags flags, void *pages) 
+{
+  void *p;
+
+  while ((p = palloc_get_page (flags)) != NULL)
+    {
+      *(void **) p = pages;
+      pages = p;
+    }
+  return pages;
+}
+
+/* Writes a pattern to each of the PAGE_CNT pages at PAGES and
+   reads it back. */
+static void
+check_pages (uint8_t *pages, size_t page_cnt, const char *name) 
+{
+  size_t i;
+
+  if (!is_vmalloc_vaddr (pages)
+      || !is_vmalloc_vaddr (pages + page_cnt * PGSIZE - 1))
+    fail ("%s at %p not in the vmalloc region", name, pages);
+  for (i = 0; i < page_cnt * PGSIZE; i++)
+    pages[i] = i / PGSIZE + 1;
+  for (i = 0; i < page_cnt * PGSIZE; i++)
+    if (pages[i] != i / PGSIZE + 1)
+      fail ("%s byte %zu is corrupt", name, i);
+}
+
+/* Fails unless B starts outside the PAGE_CNT pages at A and the
+   guard page that follows them. */
+static void
+check_apart (uint8_t *a, uint8_t *b, size_t page_cnt) 
+{
+  if (b >= a && b < a + (page_cnt + 1) * PGSIZE)
+    fail ("%p overlaps %p or its guard page", b, a);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vmalloc) begin
+(vmalloc) Allocating two 3-page areas.
+(vmalloc) Fragmenting the page pools.
+(vmalloc) Allocating a big block with malloc().
+(vmalloc) end
+EOF
+pass;
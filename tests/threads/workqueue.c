@@ -0,0 +1,60 @@
+/* Tests deferred work: checks that work items run in the worker
+   thread for their class, in the order queued, that queuing a
+   pending item again does not make it run twice, and that a
+   cancelled item does not run. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+#define ITEM_CNT 4
+
+static work_func work_item;
+
+static struct work items[ITEM_CNT];
+static struct semaphore done;
+
+void
+test_workqueue (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  for (i = 0; i < ITEM_CNT; i++)
+    work_init (&items[i], work_item, (void *) i);
+
+  /* The low-priority worker cannot run until we block. */
+  for (i = 0; i < 3; i++)
+    {
+      work_queue (&items[i], WORK_LOW);
+      msg ("Queued item %d.", i);
+    }
+  msg ("Queuing item 0 again: %s.",
+       work_queue (&items[0], WORK_LOW) ? "FAILED" : "already pending");
+  msg ("Cancelling item 1: %s.",
+       work_cancel (&items[1]) ? "was pending" : "FAILED");
+  sema_down (&done);
+  sema_down (&done);
+  msg ("Cancelling item 2 after it ran: %s.",
+       work_cancel (&items[2]) ? "FAILED" : "was not pending");
+
+  /* The normal-priority worker outranks us, so it runs the item
+     before work_queue() returns. */
+  work_queue (&items[3], WORK_NORMAL);
+  msg ("Queued item 3.");
+  sema_down (&done);
+}
+
+/* Work function for item number AUX. */
+static void
+work_item (void *aux) 
+{
+  msg ("Item %d running in %s.", (int) aux, thread_name ());
+  sema_up (&done);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) Queued item 0.
+(workqueue) Queued item 1.
+(workqueue) Queued item 2.
+(workqueue) Queuing item 0 again: already pending.
+(workqueue) Cancelling item 1: was pending.
+(workqueue) Item 0 running in work-low.
+(workqueue) Item 2 running in work-low.
+(workqueue) Cancelling item 2 after it ran: was not pending.
+(workqueue) Item 3 running in work-normal.
+(workqueue) Queued item 3.
+(workqueue) end
+EOF
+pass;
@@ -0,0 +1,12 @@
+/* Executes a child process whose command line spans two pages
+   in virtual address space, which must succeed. */
+
+#include <syscall.h>
+#include "tests/userprog/boundary.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  wait (exec (copy_string_across_boundary ("child-args arg-across-pages")));
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF']);
+(rusage-bad-ptr) begin
+(rusage-bad-ptr) end
+rusage-bad-ptr: exit(0)
+EOF
+(rusage-bad-ptr) begin
+rusage-bad-ptr: exit(-1)
+EOF
+pass;
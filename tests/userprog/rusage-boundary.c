@@ -0,0 +1,21 @@
+/* Gets resource usage into a buffer that spans two pages in
+   virtual address space, which must succeed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/boundary.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct rusage *usage;
+
+  usage = (struct rusage *) ((char *) get_boundary_area ()
+                             - sizeof *usage / 2);
+  memset (usage, 0xff, sizeof *usage);
+  CHECK (rusage (RUSAGE_CHILDREN, usage), "rusage(RUSAGE_CHILDREN)");
+  if (usage->user_ticks != 0 || usage->page_faults != 0)
+    fail ("usage not copied across the page boundary");
+}
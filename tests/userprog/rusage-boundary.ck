@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rusage-boundary) begin
+(rusage-boundary) rusage(RUSAGE_CHILDREN)
+(rusage-boundary) end
+rusage-boundary: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Waits for a child process, after which its resource usage is
+   available both on its own and as part of that of all
+   waited-for children.  Also passes a bogus pid, which must
+   fail. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct rusage usage, children;
+  pid_t child;
+
+  CHECK (!rusage (1234567, &usage), "rusage(1234567) must fail");
+  child = exec ("child-simple");
+  msg ("wait(exec()) = %d", wait (child));
+  CHECK (rusage (child, &usage), "rusage(child) after wait");
+  CHECK (rusage (RUSAGE_CHILDREN, &children), "rusage(RUSAGE_CHILDREN)");
+  if (children.user_ticks < usage.user_ticks
+      || children.kernel_ticks < usage.kernel_ticks
+      || children.page_faults < usage.page_faults)
+    fail ("child's usage not included in RUSAGE_CHILDREN");
+}
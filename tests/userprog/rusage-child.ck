@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rusage-child) begin
+(rusage-child) rusage(1234567) must fail
+(child-simple) run
+child-simple: exit(81)
+(rusage-child) wait(exec()) = 81
+(rusage-child) rusage(child) after wait
+(rusage-child) rusage(RUSAGE_CHILDREN)
+(rusage-child) end
+rusage-child: exit(0)
+EOF
+pass;
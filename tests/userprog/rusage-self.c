@@ -0,0 +1,22 @@
+/* Gets the resource usage of the calling process and of its
+   children, of which it has none yet. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct rusage usage;
+
+  CHECK (rusage (RUSAGE_SELF, &usage), "rusage(RUSAGE_SELF)");
+  if (usage.user_ticks < 0 || usage.kernel_ticks < 0)
+    fail ("negative tick counts");
+
+  CHECK (rusage (RUSAGE_CHILDREN, &usage), "rusage(RUSAGE_CHILDREN)");
+  if (usage.user_ticks != 0 || usage.kernel_ticks != 0
+      || usage.voluntary_switches != 0 || usage.involuntary_switches != 0
+      || usage.page_faults != 0)
+    fail ("nonzero usage without any children");
+}
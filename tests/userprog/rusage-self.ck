@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rusage-self) begin
+(rusage-self) rusage(RUSAGE_SELF)
+(rusage-self) rusage(RUSAGE_CHILDREN)
+(rusage-self) end
+rusage-self: exit(0)
+EOF
+pass;
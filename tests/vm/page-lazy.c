@@ -0,0 +1,50 @@
+/* Checks that the pages of an executable's initialized data and
+   BSS are loaded with the right contents when they are first
+   touched, in reverse order, and that touching fresh BSS pages
+   takes a page fault for each of them. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DATA_PAGES 16
+#define BSS_PAGES 16
+
+/* Initializes data page N to N + 1. */
+#define PAGE(N) [(N) * 4096 ... (N) * 4096 + 4095] = (N) + 1
+
+static char data[DATA_PAGES * 4096] =
+  {
+    PAGE (0), PAGE (1), PAGE (2), PAGE (3),
+    PAGE (4), PAGE (5), PAGE (6), PAGE (7),
+    PAGE (8), PAGE (9), PAGE (10), PAGE (11),
+    PAGE (12), PAGE (13), PAGE (14), PAGE (15),
+  };
+
+static char bss[BSS_PAGES * 4096];
+
+void
+test_main (void)
+{
+  struct rusage before, after;
+  size_t i;
+
+  msg ("check data");
+  for (i = sizeof data; i-- > 0; )
+    if (data[i] != (char) (i / 4096 + 1))
+      fail ("data byte %zu is %d, expected %d",
+            i, data[i], (int) (i / 4096 + 1));
+
+  msg ("check bss");
+  CHECK (rusage (RUSAGE_SELF, &before), "rusage before touching bss");
+  for (i = sizeof bss; i > 0; i -= 4096)
+    if (bss[i - 1] != 0)
+      fail ("bss byte %zu is nonzero", i - 1);
+  CHECK (rusage (RUSAGE_SELF, &after), "rusage after touching bss");
+
+  /* The first and last BSS pages may be shared with other
+     variables that were touched already. */
+  if (after.page_faults - before.page_faults < BSS_PAGES - 2)
+    fail ("only %u page faults touching %d bss pages",
+          after.page_faults - before.page_faults, BSS_PAGES);
+}
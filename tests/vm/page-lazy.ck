@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-lazy) begin
+(page-lazy) check data
+(page-lazy) check bss
+(page-lazy) rusage before touching bss
+(page-lazy) rusage after touching bss
+(page-lazy) end
+EOF
+pass;
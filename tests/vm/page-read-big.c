@@ -0,0 +1,38 @@
+/* Writes a file that spans many pages, then reads all of it back
+   with a single read() into a BSS buffer whose pages have never
+   been touched, and checks the result.  The read buffer does not
+   start on a page boundary, so every page of it must be brought
+   in and pinned for the duration of the call. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (32 * 4096 + 123)
+
+static char wbuf[SIZE];
+static char rbuf[SIZE + 1];
+
+void
+test_main (void)
+{
+  int handle;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    wbuf[i] = i * 7 + i / 4096;
+
+  CHECK (create ("big", SIZE), "create \"big\"");
+  CHECK ((handle = open ("big")) > 1, "open \"big\"");
+  CHECK (write (handle, wbuf, SIZE) == SIZE, "write \"big\"");
+  close (handle);
+
+  CHECK ((handle = open ("big")) > 1, "open \"big\" for verification");
+  CHECK (read (handle, rbuf + 1, SIZE) == SIZE, "read \"big\"");
+  close (handle);
+
+  for (i = 0; i < SIZE; i++)
+    if (rbuf[i + 1] != wbuf[i])
+      fail ("byte %zu read back as %d, expected %d",
+            i, rbuf[i + 1], wbuf[i]);
+}
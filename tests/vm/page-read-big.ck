@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-read-big) begin
+(page-read-big) create "big"
+(page-read-big) open "big"
+(page-read-big) write "big"
+(page-read-big) open "big" for verification
+(page-read-big) read "big"
+(page-read-big) end
+EOF
+pass;
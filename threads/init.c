@@ -22,6 +22,8 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -31,6 +33,10 @@
 #else
 #include "tests/threads/tests.h"
 #endif
+#ifdef VM
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
@@ -57,6 +63,10 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -zr: Number of zeroed pages to keep in reserve in each memory
+   pool. */
+static size_t zero_reserve_pages = 16;
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -98,6 +108,7 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  vmalloc_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -107,6 +118,7 @@ main (void)
 
   /* Initialize interrupt handlers. */
   intr_init ();
+  workqueue_init ();
   timer_init ();
   kbd_init ();
   input_init ();
@@ -114,9 +126,14 @@ main (void)
   exception_init ();
   syscall_init ();
 #endif
+#ifdef VM
+  page_init ();
+#endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  workqueue_start ();
+  palloc_start_zeroing (zero_reserve_pages);
   serial_init_queue ();
   timer_calibrate ();
 
@@ -125,6 +142,9 @@ main (void)
   ide_init ();
   locate_block_devices ();
   filesys_init (format_filesys);
+#ifdef VM
+  swap_init ();
+#endif
 #endif
 
   printf ("Boot complete.\n");
@@ -256,6 +276,8 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-zr"))
+        zero_reserve_pages = atoi (value);
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -379,6 +401,7 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -zr=COUNT          Keep COUNT zeroed pages ready in each pool.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
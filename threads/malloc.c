@@ -5,42 +5,74 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
-
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
+   The size of each request, in bytes, is rounded up to the next
+   size class and assigned to the "descriptor" that manages
+   blocks of that size.  Size classes go up in 16-byte steps to
+   128 bytes, then in four steps per power of 2 up to 2 kB, so
+   that no block is more than 25% bigger than requested (apart
+   from the smallest).  The descriptor for a size is found with
+   a lookup table indexed by the size in 16-byte units.  The
+   descriptor keeps a list of free blocks.  If the free list is
+   nonempty, one of its blocks is used to satisfy the request.
+
+   Otherwise, a new "arena" of one or more pages is obtained from
+   the page allocator (if none is available, malloc() returns a
+   null pointer).  The new arena is divided into blocks, all of
+   which are added to the descriptor's free list.  Then we return
+   one of the new blocks.  Small classes use one-page arenas;
+   larger ones use arenas of up to ARENA_MAX_PAGES pages when
+   that wastes less of the arena at the end.  Blocks in a
+   multi-page arena may cross page boundaries, so the pages after
+   the first are recorded in `arena_ofs', which lets a block find
+   its arena's header.
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
+   Blocks bigger than the largest size class are handled by
+   allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If
+   physical memory is too fragmented to provide enough contiguous
+   pages, a big block is instead built from scattered pages with
+   vmalloc().
+
+   Each descriptor counts its blocks in use and free and its
+   arenas, and big blocks are counted separately; see
+   malloc_print_stats().  If the kernel is built with
+   MALLOC_PROFILE defined (for example, by adding -DMALLOC_PROFILE
+   to DEFINES in Make.vars), each block is also tagged with the
+   address of the code that allocated it, and live bytes are
+   totalled by call site. */
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
+    size_t arena_pages;         /* Number of pages in an arena. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+#ifdef MALLOC_PROFILE
+    char name[16];              /* Lock name, e.g. "malloc 16". */
+#endif
+
+    /* Statistics, protected by `lock'. */
+    size_t in_use;              /* Blocks allocated. */
+    size_t max_in_use;          /* Most blocks ever allocated at once. */
+    size_t free_cnt;            /* Blocks on free_list. */
+    size_t arena_cnt;           /* Arenas. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -60,34 +92,159 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Largest size class.  Bigger blocks get pages of their own. */
+#define MAX_BLOCK_SIZE 2048
+
+/* Most pages in an arena. */
+#define ARENA_MAX_PAGES 4
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[24];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Maps a size, rounded up to a multiple of 16 bytes and divided
+   by 16, to the index of the descriptor for that size. */
+static uint8_t desc_idx[MAX_BLOCK_SIZE / 16 + 1];
+
+/* For each page of physical memory, the number of pages from the
+   start of the page to the start of the multi-page arena that
+   contains it, or 0 if it does not lie past the first page of a
+   multi-page arena.  Indexed by physical page number. */
+static uint8_t *arena_ofs;
+
+/* Big block statistics.  Updated with interrupts off. */
+static size_t big_cnt;          /* Big blocks allocated. */
+static size_t big_pages;        /* Pages in big blocks. */
+static size_t max_big_pages;    /* Most pages ever in big blocks. */
+
+#ifdef MALLOC_PROFILE
+/* Tag placed in front of each block in profiling mode. */
+struct site_tag
+  {
+    void *caller;               /* Return address of allocator's caller. */
+    size_t size;                /* Bytes requested. */
+  };
+
+/* Allocations from one call site. */
+struct alloc_site
+  {
+    void *caller;               /* Call site, or null if slot unused. */
+    size_t bytes;               /* Bytes live. */
+    size_t blocks;              /* Blocks live. */
+    size_t max_bytes;           /* Most bytes ever live. */
+    unsigned long long alloc_cnt; /* Allocations ever. */
+  };
+
+/* Call sites, in an open-addressed hash table keyed by caller.
+   Allocations from sites that do not fit are charged to
+   `other_site'.  Updated with interrupts off. */
+#define SITE_CNT 256
+static struct alloc_site sites[SITE_CNT];
+static struct alloc_site other_site;
+
+static void *malloc_at (size_t, void *caller);
+static struct alloc_site *site_lookup (void *caller);
+static void site_print (const struct alloc_site *);
+#endif
+
+static void big_stats_add (int blocks, long pages);
+static void *block_alloc (size_t);
+static bool resize_in_place (void *, size_t);
+static void block_free (void *);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void set_arena_ofs (struct arena *, size_t page_cnt, bool);
+
+/* Returns the number of pages to use for an arena of blocks of
+   BLOCK_SIZE bytes: the fewest pages that waste no more than
+   1/16 of the arena, or failing that, whatever number up to
+   ARENA_MAX_PAGES wastes the smallest fraction. */
+static size_t
+arena_pages_for (size_t block_size)
+{
+  size_t best = 0, best_waste = 0;
+  size_t pages;
+
+  for (pages = 1; pages <= ARENA_MAX_PAGES; pages++)
+    {
+      size_t waste = (pages * PGSIZE - sizeof (struct arena)) % block_size
+                     + sizeof (struct arena);
+      if (waste * 16 <= pages * PGSIZE)
+        return pages;
+      if (best == 0 || waste * best < best_waste * pages)
+        {
+          best = pages;
+          best_waste = waste;
+        }
+    }
+  return best;
+}
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) 
 {
-  size_t block_size;
+  size_t block_size, i;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+  block_size = 16;
+  while (block_size <= MAX_BLOCK_SIZE)
     {
       struct desc *d = &descs[desc_cnt++];
+      size_t step;
+
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->arena_pages = arena_pages_for (block_size);
+      d->blocks_per_arena = ((d->arena_pages * PGSIZE - sizeof (struct arena))
+                             / block_size);
       list_init (&d->free_list);
+      /* Every malloc() and free() takes this lock, so only time
+         it when profiling. */
+#ifdef MALLOC_PROFILE
+      snprintf (d->name, sizeof d->name, "malloc %zu", block_size);
+      lock_init_named (&d->lock, d->name);
+#else
       lock_init (&d->lock);
+#endif
+
+      /* 16-byte steps up to 128 bytes, then a quarter of the
+         power of 2 at or below BLOCK_SIZE. */
+      step = block_size < 128 ? 16 : 32;
+      while (block_size >= 128 && step * 8 <= block_size)
+        step *= 2;
+      block_size += step;
+    }
+
+  /* Build the size lookup table. */
+  for (i = 0; i < sizeof desc_idx; i++)
+    {
+      size_t idx = 0;
+      while (descs[idx].block_size < i * 16)
+        idx++;
+      desc_idx[i] = idx;
     }
+
+  arena_ofs = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                   DIV_ROUND_UP (init_ram_pages, PGSIZE));
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+#ifdef MALLOC_PROFILE
+  return malloc_at (size, __builtin_return_address (0));
+#else
+  return block_alloc (size);
+#endif
+}
+
+/* Obtains and returns a new block of at least SIZE bytes, not
+   counting any profiling tag.  Returns a null pointer if memory
+   is not available. */
+static void *
+block_alloc (size_t size) 
 {
   struct desc *d;
   struct block *b;
@@ -97,17 +254,14 @@ malloc (size_t size)
   if (size == 0)
     return NULL;
 
-  /* Find the smallest descriptor that satisfies a SIZE-byte
-     request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  if (size > MAX_BLOCK_SIZE) 
     {
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL && page_cnt > 1)
+        a = vmalloc (0, page_cnt);
       if (a == NULL)
         return NULL;
 
@@ -116,9 +270,15 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      big_stats_add (1, page_cnt);
       return a + 1;
     }
 
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  d = &descs[desc_idx[DIV_ROUND_UP (size, 16)]];
+  ASSERT (d->block_size >= size);
+
   lock_acquire (&d->lock);
 
   /* If the free list is empty, create a new arena. */
@@ -126,8 +286,8 @@ malloc (size_t size)
     {
       size_t i;
 
-      /* Allocate a page. */
-      a = palloc_get_page (0);
+      /* Allocate pages. */
+      a = palloc_get_multiple (0, d->arena_pages);
       if (a == NULL) 
         {
           lock_release (&d->lock);
@@ -135,6 +295,7 @@ malloc (size_t size)
         }
 
       /* Initialize arena and add its blocks to the free list. */
+      set_arena_ofs (a, d->arena_pages, true);
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
@@ -143,12 +304,17 @@ malloc (size_t size)
           struct block *b = arena_to_block (a, i);
           list_push_back (&d->free_list, &b->free_elem);
         }
+      d->free_cnt += d->blocks_per_arena;
+      d->arena_cnt++;
     }
 
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
   a->free_cnt--;
+  d->free_cnt--;
+  if (++d->in_use > d->max_in_use)
+    d->max_in_use = d->in_use;
   lock_release (&d->lock);
   return b;
 }
@@ -167,22 +333,38 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
+#ifdef MALLOC_PROFILE
+  p = malloc_at (size, __builtin_return_address (0));
+#else
   p = malloc (size);
+#endif
   if (p != NULL)
     memset (p, 0, size);
 
   return p;
 }
 
-/* Returns the number of bytes allocated for BLOCK. */
+/* Returns the number of bytes allocated for BLOCK, not counting
+   any profiling tag. */
 static size_t
 block_size (void *block) 
 {
-  struct block *b = block;
-  struct arena *a = block_to_arena (b);
-  struct desc *d = a->desc;
+  struct block *b;
+  struct arena *a;
+  struct desc *d;
+  size_t size;
 
-  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+#ifdef MALLOC_PROFILE
+  block = (struct site_tag *) block - 1;
+#endif
+  b = block;
+  a = block_to_arena (b);
+  d = a->desc;
+  size = d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+#ifdef MALLOC_PROFILE
+  size -= sizeof (struct site_tag);
+#endif
+  return size;
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -190,7 +372,11 @@ block_size (void *block)
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
-   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK).
+
+   OLD_BLOCK is resized in place, without copying, if it is
+   already big enough or, for a big block, if the pages that
+   follow it are free. */
 void *
 realloc (void *old_block, size_t new_size) 
 {
@@ -199,9 +385,15 @@ realloc (void *old_block, size_t new_size)
       free (old_block);
       return NULL;
     }
+  else if (old_block != NULL && resize_in_place (old_block, new_size))
+    return old_block;
   else 
     {
+#ifdef MALLOC_PROFILE
+      void *new_block = malloc_at (new_size, __builtin_return_address (0));
+#else
       void *new_block = malloc (new_size);
+#endif
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -213,10 +405,96 @@ realloc (void *old_block, size_t new_size)
     }
 }
 
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   A block from a descriptor can only stay where it is if it is
+   already big enough.  A big block gives back the pages it no
+   longer needs, or grows into the pages that follow it if they
+   are free.  A big block from vmalloc() is never resized.
+   Returns true if successful, false if BLOCK must be moved. */
+static bool
+resize_in_place (void *block, size_t new_size) 
+{
+  struct arena *a;
+  size_t raw_size = new_size;
+  bool success;
+
+#ifdef MALLOC_PROFILE
+  struct site_tag *tag = (struct site_tag *) block - 1;
+  block = tag;
+  raw_size += sizeof *tag;
+#endif
+  a = block_to_arena (block);
+
+  if (a->desc != NULL)
+    success = raw_size <= a->desc->block_size;
+  else if (is_vmalloc_vaddr (a))
+    success = DIV_ROUND_UP (raw_size + sizeof *a, PGSIZE) == a->free_cnt;
+  else
+    {
+      size_t old_pages = a->free_cnt;
+      size_t new_pages = DIV_ROUND_UP (raw_size + sizeof *a, PGSIZE);
+
+      if (new_pages < old_pages)
+        {
+          palloc_free_multiple ((uint8_t *) a + new_pages * PGSIZE,
+                                old_pages - new_pages);
+          success = true;
+        }
+      else
+        success = (new_pages == old_pages
+                   || palloc_extend (a, old_pages, new_pages));
+      if (success)
+        {
+          a->free_cnt = new_pages;
+          big_stats_add (0, (long) new_pages - (long) old_pages);
+        }
+    }
+
+#ifdef MALLOC_PROFILE
+  if (success)
+    {
+      struct alloc_site *site;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      site = site_lookup (tag->caller);
+      site->bytes += new_size - tag->size;
+      if (site->bytes > site->max_bytes)
+        site->max_bytes = site->bytes;
+      tag->size = new_size;
+      intr_set_level (old_level);
+    }
+#endif
+  return success;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) 
+{
+#ifdef MALLOC_PROFILE
+  if (p != NULL)
+    {
+      struct site_tag *tag = (struct site_tag *) p - 1;
+      struct alloc_site *site;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      site = site_lookup (tag->caller);
+      site->bytes -= tag->size;
+      site->blocks--;
+      intr_set_level (old_level);
+
+      p = tag;
+    }
+#endif
+  block_free (p);
+}
+
+/* Frees block P, not counting any profiling tag. */
+static void
+block_free (void *p) 
 {
   if (p != NULL)
     {
@@ -237,6 +515,8 @@ free (void *p)
 
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
+          d->free_cnt++;
+          d->in_use--;
 
           /* If the arena is now entirely unused, free it. */
           if (++a->free_cnt >= d->blocks_per_arena) 
@@ -249,7 +529,10 @@ free (void *p)
                   struct block *b = arena_to_block (a, i);
                   list_remove (&b->free_elem);
                 }
-              palloc_free_page (a);
+              set_arena_ofs (a, d->arena_pages, false);
+              palloc_free_multiple (a, d->arena_pages);
+              d->free_cnt -= d->blocks_per_arena;
+              d->arena_cnt--;
             }
 
           lock_release (&d->lock);
@@ -257,7 +540,11 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          big_stats_add (-1, -(long) a->free_cnt);
+          if (is_vmalloc_vaddr (a))
+            vfree (a, a->free_cnt);
+          else
+            palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
@@ -267,7 +554,16 @@ free (void *p)
 static struct arena *
 block_to_arena (struct block *b)
 {
-  struct arena *a = pg_round_down (b);
+  uint8_t *page = pg_round_down (b);
+  size_t page_no = pg_no (page) - pg_no (PHYS_BASE);
+  struct arena *a;
+
+  /* Step back to the first page of a multi-page arena.  Big
+     blocks from vmalloc() lie outside physical memory, but their
+     header is always in the block's own page. */
+  if (page_no < init_ram_pages)
+    page -= arena_ofs[page_no] * PGSIZE;
+  a = (struct arena *) page;
 
   /* Check that the arena is valid. */
   ASSERT (a != NULL);
@@ -275,7 +571,8 @@ block_to_arena (struct block *b)
 
   /* Check that the block is properly aligned for the arena. */
   ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+          || ((uint8_t *) b - (uint8_t *) (a + 1))
+             % a->desc->block_size == 0);
   ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
   return a;
@@ -292,3 +589,127 @@ arena_to_block (struct arena *a, size_t idx)
                            + sizeof *a
                            + idx * a->desc->block_size);
 }
+
+/* Records in `arena_ofs' that the PAGE_CNT pages starting at A
+   belong to arena A, if SET is true, or that they no longer do,
+   if SET is false. */
+static void
+set_arena_ofs (struct arena *a, size_t page_cnt, bool set)
+{
+  size_t page_no = pg_no (a) - pg_no (PHYS_BASE);
+  size_t i;
+
+  for (i = 1; i < page_cnt; i++)
+    arena_ofs[page_no + i] = set ? i : 0;
+}
+
+/* Adds BLOCKS and PAGES, either of which may be negative, to the
+   big block statistics. */
+static void
+big_stats_add (int blocks, long pages)
+{
+  enum intr_level old_level = intr_disable ();
+  big_cnt += blocks;
+  big_pages += pages;
+  if (big_pages > max_big_pages)
+    max_big_pages = big_pages;
+  intr_set_level (old_level);
+}
+
+/* Prints heap statistics: for each size class, blocks in use and
+   free and arenas; pages in big blocks; and, when profiling, the
+   live bytes from each call site.  May be called at any time. */
+void
+malloc_print_stats (void)
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->max_in_use > 0)
+      printf ("Malloc %zu-byte blocks: %zu in use (max %zu), %zu free, "
+              "%zu arenas of %zu pages\n", d->block_size, d->in_use,
+              d->max_in_use, d->free_cnt, d->arena_cnt, d->arena_pages);
+  printf ("Malloc big blocks: %zu blocks, %zu pages (max %zu)\n",
+          big_cnt, big_pages, max_big_pages);
+
+#ifdef MALLOC_PROFILE
+  {
+    struct alloc_site *s;
+
+    for (s = sites; s < sites + SITE_CNT; s++)
+      if (s->caller != NULL && s->bytes > 0)
+        site_print (s);
+    if (other_site.alloc_cnt > 0)
+      site_print (&other_site);
+  }
+#endif
+}
+
+#ifdef MALLOC_PROFILE
+/* Allocates a SIZE-byte block on behalf of CALLER, tagging it
+   and charging it to CALLER's call site. */
+static void *
+malloc_at (size_t size, void *caller)
+{
+  struct site_tag *tag;
+  struct alloc_site *site;
+  enum intr_level old_level;
+
+  if (size == 0)
+    return NULL;
+
+  tag = block_alloc (size + sizeof *tag);
+  if (tag == NULL)
+    return NULL;
+  tag->caller = caller;
+  tag->size = size;
+
+  old_level = intr_disable ();
+  site = site_lookup (caller);
+  site->bytes += size;
+  site->blocks++;
+  site->alloc_cnt++;
+  if (site->bytes > site->max_bytes)
+    site->max_bytes = site->bytes;
+  intr_set_level (old_level);
+
+  return tag + 1;
+}
+
+/* Returns the call site record for CALLER, creating it if
+   necessary, or `other_site' if the table is full.  Must be
+   called with interrupts off. */
+static struct alloc_site *
+site_lookup (void *caller)
+{
+  size_t start = ((uintptr_t) caller >> 2) % SITE_CNT;
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < SITE_CNT; i++)
+    {
+      struct alloc_site *s = &sites[(start + i) % SITE_CNT];
+      if (s->caller == caller)
+        return s;
+      if (s->caller == NULL)
+        {
+          s->caller = caller;
+          return s;
+        }
+    }
+  return &other_site;
+}
+
+/* Prints the statistics for call site S. */
+static void
+site_print (const struct alloc_site *s)
+{
+  if (s->caller != NULL)
+    printf ("Malloc site %p", s->caller);
+  else
+    printf ("Malloc other sites");
+  printf (": %zu bytes in %zu blocks (max %zu bytes), %llu allocs\n",
+          s->bytes, s->blocks, s->max_bytes, s->alloc_cnt);
+}
+#endif /* MALLOC_PROFILE */
@@ -2,14 +2,16 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -22,23 +24,107 @@
    even if user processes are swapping like mad.
 
    By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   half to the user pool.  Neither half is a hard limit, though:
+   a pool that runs out of pages borrows them from the other one.
+   The lender grants its borrower a "loan" of LOAN_CHUNK pages at
+   a time, and only while it has at least its high watermark of
+   free pages to spare, so that it always keeps some memory for
+   its own use.  The borrower then takes pages from the lender's
+   free lists, up to the amount of the loan.  Borrowed pages go
+   back to the lender when they are freed, and unused loan
+   chunks are reclaimed as the borrower gives back pages or as
+   the lender drops below its low watermark.  If a user page
+   limit is given with -ul, the user pool never borrows.
+
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept in blocks of 2**ORDER pages, each aligned (relative to the
+   pool's base) to its own size, on one free list per order.  An
+   allocation takes the smallest free block that is big enough,
+   splitting larger blocks in half as needed, and gives back the
+   pages it does not need.  A freed block is merged with its
+   "buddy", the other half of the block it was split from,
+   whenever the buddy is free too.  Both take time logarithmic in
+   the size of the pool, no matter how full the pool is.
+
+   The free lists are threaded through the free pages themselves.
+   For each page, the pool records the order of the free block
+   starting there, if any, which is what lets a block find out
+   whether its buddy is free.  A bitmap of allocated pages is
+   kept as well, to catch double frees.
+
+   Once palloc_start_zeroing() has been called, each pool also
+   keeps a reserve of pages that have already been zeroed, so
+   that single-page PAL_ZERO requests need not zero a page on
+   the spot.  The reserve is refilled by a low-priority work
+   item, which runs only when nothing more important is ready.
+   Reserve pages count as allocated, but any single-page request
+   falls back on the reserve when the pool is otherwise empty,
+   and a multi-page request that fails drains it back into the
+   pool and tries again. */
+
+/* Number of block orders.  The largest block is
+   2**(ORDER_CNT - 1) pages. */
+#define ORDER_CNT 16
+
+/* Value in a pool's `orders' array for a page that does not
+   start a free block. */
+#define NOT_FREE 0xff
+
+/* Pages lent at a time from one pool to the other. */
+#define LOAN_CHUNK 64
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Mutual exclusion. */
+    struct bitmap *used_map;            /* Bitmap of allocated pages. */
+    uint8_t *orders;                    /* Order of free block at each page. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks of each order. */
+    size_t free_cnt[ORDER_CNT];         /* Number of blocks in each list. */
+    size_t free_pages;                  /* Pages in free blocks. */
+    const char *name;                   /* Name, for statistics. */
+
+    /* Lending to the other pool. */
+    struct pool *borrower;              /* Pool that may borrow, or null. */
+    struct bitmap *lent_map;            /* Bitmap of lent pages. */
+    size_t lent;                        /* Pages lent out now. */
+    size_t loan;                        /* Pages the borrower may hold. */
+    size_t low_wm, high_wm;             /* Free page watermarks. */
+    unsigned long long grant_cnt;       /* Loan chunks granted. */
+    unsigned long long reclaim_cnt;     /* Loan chunks reclaimed. */
+    unsigned long long borrow_fails;    /* Pages our borrower was denied. */
+
+    /* Reserve of zeroed pages, linked through the pages. */
+    struct list zeroed;                 /* Zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pages in `zeroed'. */
+    unsigned long long zero_hits;       /* PAL_ZERO served from reserve. */
+    unsigned long long zero_misses;     /* PAL_ZERO zeroed on the spot. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Zeroed pages to keep in each pool's reserve, or 0 if the
+   reserve is not in use. */
+static size_t zero_target;
+
+/* Work item that refills the reserves. */
+static struct work zero_work;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void take_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void *borrow_range (struct pool *lender, size_t page_cnt);
+static bool cover_loan (struct pool *lender, size_t page_cnt);
+static void reclaim_loan (struct pool *);
+static void pool_print_stats (const struct pool *);
+static void *take_zeroed (struct pool *);
+static bool drain_zeroed (struct pool *);
+static work_func refill_zeroed;
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -59,6 +145,250 @@ palloc_init (size_t user_page_limit)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+
+  /* Let each pool borrow from the other, unless the user pool
+     was explicitly limited. */
+  user_pool.borrower = &kernel_pool;
+  if (user_page_limit == SIZE_MAX)
+    kernel_pool.borrower = &user_pool;
+}
+
+/* Returns the smallest order of block that holds PAGE_CNT
+   pages. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Returns the address of page PAGE_IDX in POOL. */
+static void *
+page_addr (const struct pool *pool, size_t page_idx)
+{
+  return pool->base + PGSIZE * page_idx;
+}
+
+/* Returns the list element of the free block that starts at page
+   PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx)
+{
+  return page_addr (pool, page_idx);
+}
+
+/* Adds the block of ORDER at page PAGE_IDX to POOL's free
+   lists.  Must be called with POOL's lock held. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->orders[page_idx] = order;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+  pool->free_cnt[order]++;
+  pool->free_pages += (size_t) 1 << order;
+}
+
+/* Removes the free block of ORDER at page PAGE_IDX from POOL's
+   free lists.  Must be called with POOL's lock held. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->orders[page_idx] == order);
+
+  pool->orders[page_idx] = NOT_FREE;
+  list_remove (block_elem (pool, page_idx));
+  pool->free_cnt[order]--;
+  pool->free_pages -= (size_t) 1 << order;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is big
+   enough.  Must be called with POOL's lock held. */
+static size_t
+alloc_locked (struct pool *pool, size_t page_cnt)
+{
+  int want = order_for (page_cnt);
+  int order;
+  size_t page_idx;
+
+  if (want >= ORDER_CNT)
+    return BITMAP_ERROR;
+
+  /* Find the smallest free block that is big enough. */
+  for (order = want; order < ORDER_CNT; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order == ORDER_CNT)
+    return BITMAP_ERROR;
+  page_idx = pg_no (list_front (&pool->free_lists[order])) - pg_no (pool->base);
+  remove_block (pool, page_idx, order);
+
+  /* Split it down to the size wanted, freeing the upper halves. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+
+  /* Give back the pages past PAGE_CNT. */
+  free_range (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+
+  ASSERT (!bitmap_contains (pool->used_map, page_idx, page_cnt, true));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+
+  /* Stop lending if we are running short ourselves. */
+  if (pool->free_pages < pool->low_wm)
+    reclaim_loan (pool);
+
+  return page_idx;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is big
+   enough. */
+static size_t
+alloc_range (struct pool *pool, size_t page_cnt)
+{
+  size_t page_idx;
+
+  spinlock_acquire (&pool->lock);
+  page_idx = alloc_locked (pool, page_cnt);
+  spinlock_release (&pool->lock);
+
+  return page_idx;
+}
+
+/* Allocates PAGE_CNT contiguous pages from LENDER on behalf of
+   the pool that borrows from it, growing the borrower's loan by
+   whole chunks if LENDER can spare them.  Returns the pages, or
+   a null pointer if the loan cannot cover them. */
+static void *
+borrow_range (struct pool *lender, size_t page_cnt)
+{
+  size_t page_idx = BITMAP_ERROR;
+
+  spinlock_acquire (&lender->lock);
+  if (cover_loan (lender, page_cnt))
+    page_idx = alloc_locked (lender, page_cnt);
+  if (page_idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (lender->lent_map, page_idx, page_cnt, true);
+      lender->lent += page_cnt;
+    }
+  else
+    lender->borrow_fails += page_cnt;
+  spinlock_release (&lender->lock);
+
+  return page_idx != BITMAP_ERROR ? page_addr (lender, page_idx) : NULL;
+}
+
+/* Returns true if the loan LENDER has granted its borrower
+   leaves room to lend PAGE_CNT more pages, first growing it by
+   whole chunks if LENDER can spare them.  Must be called with
+   LENDER's lock held. */
+static bool
+cover_loan (struct pool *lender, size_t page_cnt)
+{
+  if (lender->lent + page_cnt > lender->loan)
+    {
+      /* Pages already promised but not yet lent out are not ours
+         to spend either. */
+      size_t grant = ROUND_UP (lender->lent + page_cnt - lender->loan,
+                               LOAN_CHUNK);
+      size_t promised = lender->loan - lender->lent;
+
+      if (lender->free_pages >= lender->high_wm + promised + grant)
+        {
+          lender->loan += grant;
+          lender->grant_cnt += grant / LOAN_CHUNK;
+        }
+    }
+  return lender->lent + page_cnt <= lender->loan;
+}
+
+/* Shrinks the loan POOL has granted its borrower to the whole
+   chunks that are actually in use.  Must be called with POOL's
+   lock held. */
+static void
+reclaim_loan (struct pool *pool)
+{
+  size_t needed = ROUND_UP (pool->lent, LOAN_CHUNK);
+
+  if (pool->loan > needed)
+    {
+      pool->reclaim_cnt += (pool->loan - needed) / LOAN_CHUNK;
+      pool->loan = needed;
+    }
+}
+
+/* Frees the PAGE_CNT pages starting at page PAGE_IDX in POOL,
+   which need not be a single block, merging blocks with their
+   buddies where possible.  Must be called with POOL's lock
+   held. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      /* Take the largest aligned block at the front of the
+         range. */
+      int order = 0;
+      size_t idx = page_idx;
+
+      while (order + 1 < ORDER_CNT
+             && (page_idx & ((size_t) 1 << order)) == 0
+             && ((size_t) 1 << (order + 1)) <= page_cnt)
+        order++;
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+
+      /* Merge with its buddy as long as the buddy is free. */
+      while (order + 1 < ORDER_CNT)
+        {
+          size_t buddy = idx ^ ((size_t) 1 << order);
+          if (buddy >= pool->page_cnt || pool->orders[buddy] != order)
+            break;
+          remove_block (pool, buddy, order);
+          idx &= ~((size_t) 1 << order);
+          order++;
+        }
+      push_block (pool, idx, order);
+    }
+}
+
+/* Removes the PAGE_CNT pages starting at page PAGE_IDX in POOL,
+   which must all be free, from the free lists, splitting the
+   free blocks they are in and giving back the parts outside the
+   range.  Must be called with POOL's lock held. */
+static void
+take_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+
+  while (page_idx < end)
+    {
+      /* Find the free block that contains PAGE_IDX. */
+      size_t head = page_idx, block_end, take_end;
+      int order;
+
+      for (order = 0; order < ORDER_CNT; order++)
+        {
+          head = page_idx & ~(((size_t) 1 << order) - 1);
+          if (pool->orders[head] == order)
+            break;
+        }
+      ASSERT (order < ORDER_CNT);
+      block_end = head + ((size_t) 1 << order);
+      take_end = block_end < end ? block_end : end;
+
+      remove_block (pool, head, order);
+      free_range (pool, head, page_idx - head);
+      free_range (pool, take_end, block_end - take_end);
+      page_idx = take_end;
+    }
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -66,30 +396,62 @@ palloc_init (size_t user_page_limit)
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   FLAGS, in which case the kernel panics.
+
+   If the pool is out of pages, they may be borrowed from the
+   other pool. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  void *pages = NULL;
+  bool zeroed = false;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  /* Try the reserve of zeroed pages first if zeroes are wanted. */
+  if (page_cnt == 1 && (flags & PAL_ZERO))
+    {
+      pages = take_zeroed (pool);
+      zeroed = pages != NULL;
+    }
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  if (pages == NULL)
+    {
+      page_idx = alloc_range (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR && page_cnt > 1 && drain_zeroed (pool))
+        page_idx = alloc_range (pool, page_cnt);
+      if (page_idx != BITMAP_ERROR)
+        pages = page_addr (pool, page_idx);
+      else if (page_cnt == 1)
+        {
+          /* Use up the reserve before borrowing. */
+          pages = take_zeroed (pool);
+          zeroed = pages != NULL;
+        }
+    }
+  if (pages == NULL)
+    {
+      struct pool *lender = pool == &user_pool ? &kernel_pool : &user_pool;
+      if (lender->borrower == pool)
+        pages = borrow_range (lender, page_cnt);
+    }
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
+      if (page_cnt == 1 && (flags & PAL_ZERO))
+        {
+          spinlock_acquire (&pool->lock);
+          if (zeroed)
+            pool->zero_hits++;
+          else
+            pool->zero_misses++;
+          spinlock_release (&pool->lock);
+        }
     }
   else 
     {
@@ -113,7 +475,68 @@ palloc_get_page (enum palloc_flags flags)
   return palloc_get_multiple (flags, 1);
 }
 
-/* Frees the PAGE_CNT pages starting at PAGES. */
+/* Tries to grow the group of OLD_CNT pages at PAGES, obtained
+   from palloc_get_multiple(), to NEW_CNT pages by allocating the
+   pages that follow it.  Returns true if successful, false if
+   any of those pages is in use or past the end of the pool, or
+   if PAGES were borrowed and the loan cannot cover the new
+   pages. */
+bool
+palloc_extend (void *pages, size_t old_cnt, size_t new_cnt)
+{
+  struct pool *pool;
+  size_t page_idx;
+  bool borrowed, success;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (old_cnt > 0 && new_cnt >= old_cnt);
+
+  if (page_from_pool (&kernel_pool, pages))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, pages))
+    pool = &user_pool;
+  else
+    NOT_REACHED ();
+
+  page_idx = pg_no (pages) - pg_no (pool->base) + old_cnt;
+  new_cnt -= old_cnt;
+  if (page_idx + new_cnt > pool->page_cnt)
+    return false;
+
+  spinlock_acquire (&pool->lock);
+
+  /* Pages added to borrowed pages are borrowed too, so they must
+     fit within the loan. */
+  borrowed = bitmap_test (pool->lent_map, page_idx - 1);
+  success = !bitmap_contains (pool->used_map, page_idx, new_cnt, true);
+  if (success && borrowed && !cover_loan (pool, new_cnt))
+    {
+      pool->borrow_fails += new_cnt;
+      success = false;
+    }
+  if (success)
+    {
+      take_range (pool, page_idx, new_cnt);
+      bitmap_set_multiple (pool->used_map, page_idx, new_cnt, true);
+      if (borrowed)
+        {
+          bitmap_set_multiple (pool->lent_map, page_idx, new_cnt, true);
+          pool->lent += new_cnt;
+        }
+
+      /* Stop lending if we are running short ourselves. */
+      if (pool->free_pages < pool->low_wm)
+        reclaim_loan (pool);
+    }
+  spinlock_release (&pool->lock);
+
+  return success;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGES.
+
+   This function does not sleep, so it may be called with
+   interrupts off. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
@@ -137,8 +560,20 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  spinlock_acquire (&pool->lock);
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  free_range (pool, page_idx, page_cnt);
+  if (pool->lent > 0 && bitmap_test (pool->lent_map, page_idx))
+    {
+      /* Borrowed pages coming home.  Keep one spare chunk of the
+         loan to avoid regranting it right away. */
+      bitmap_set_multiple (pool->lent_map, page_idx, page_cnt, false);
+      pool->lent -= page_cnt;
+      if (pool->loan > ROUND_UP (pool->lent, LOAN_CHUNK) + LOAN_CHUNK)
+        reclaim_loan (pool);
+    }
+  spinlock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +583,183 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Starts keeping a reserve of RESERVE zeroed pages in each
+   pool, refilled in the background.  Must be called after
+   workqueue_start().  A RESERVE of 0 keeps no reserve. */
+void
+palloc_start_zeroing (size_t reserve)
+{
+  work_init (&zero_work, refill_zeroed, NULL);
+  zero_target = reserve;
+  if (zero_target > 0)
+    work_queue (&zero_work, WORK_LOW);
+}
+
+/* Removes and returns a page from POOL's reserve of zeroed pages,
+   or returns a null pointer if the reserve is empty.  Queues a
+   refill if this leaves the reserve short. */
+static void *
+take_zeroed (struct pool *pool)
+{
+  struct list_elem *e = NULL;
+  bool refill;
+
+  if (zero_target == 0)
+    return NULL;
+
+  spinlock_acquire (&pool->lock);
+  if (!list_empty (&pool->zeroed))
+    {
+      e = list_pop_front (&pool->zeroed);
+      pool->zeroed_cnt--;
+    }
+  refill = pool->zeroed_cnt < zero_target;
+  spinlock_release (&pool->lock);
+
+  if (refill)
+    work_queue (&zero_work, WORK_LOW);
+  if (e == NULL)
+    return NULL;
+
+  /* The list element was the only nonzero part. */
+  memset (e, 0, sizeof *e);
+  return e;
+}
+
+/* Returns every page in POOL's reserve of zeroed pages to the
+   pool.  Returns true if there were any. */
+static bool
+drain_zeroed (struct pool *pool)
+{
+  bool drained;
+
+  spinlock_acquire (&pool->lock);
+  drained = !list_empty (&pool->zeroed);
+  while (!list_empty (&pool->zeroed))
+    {
+      void *page = list_pop_front (&pool->zeroed);
+      size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+      bitmap_reset (pool->used_map, page_idx);
+      free_range (pool, page_idx, 1);
+    }
+  pool->zeroed_cnt = 0;
+  spinlock_release (&pool->lock);
+
+  return drained;
+}
+
+/* Work function that zeroes free pages into each pool's reserve
+   until it is full or the pool runs out of free pages. */
+static void
+refill_zeroed (void *aux UNUSED)
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+
+      while (pool->zeroed_cnt < zero_target)
+        {
+          size_t page_idx = alloc_range (pool, 1);
+          void *page;
+
+          if (page_idx == BITMAP_ERROR)
+            break;
+          page = page_addr (pool, page_idx);
+          memset (page, 0, PGSIZE);
+
+          spinlock_acquire (&pool->lock);
+          list_push_front (&pool->zeroed, page);
+          pool->zeroed_cnt++;
+          spinlock_release (&pool->lock);
+        }
+    }
+}
+
+/* Prints the number of free blocks of each order in each
+   pool, and how much each has lent to the other. */
+void
+palloc_print_stats (void)
+{
+  pool_print_stats (&kernel_pool);
+  pool_print_stats (&user_pool);
+}
+
+/* Prints the number of free blocks of each order in POOL. */
+static void
+pool_print_stats (const struct pool *pool)
+{
+  size_t free_pages = 0;
+  int order;
+
+  printf ("Palloc %s: free blocks by order:", pool->name);
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      if (pool->free_cnt[order] > 0)
+        printf (" %d:%zu", order, pool->free_cnt[order]);
+      free_pages += pool->free_cnt[order] << order;
+    }
+  printf (" (%zu of %zu pages free)\n", free_pages, pool->page_cnt);
+  ASSERT (free_pages == pool->free_pages);
+  printf ("Palloc %s: %zu pages lent (loan %zu, %llu chunks granted, "
+          "%llu reclaimed, %llu pages denied)\n",
+          pool->name, pool->lent, pool->loan, pool->grant_cnt,
+          pool->reclaim_cnt, pool->borrow_fails);
+  printf ("Palloc %s: %zu zeroed pages reserved, "
+          "%llu zeroed requests served from reserve, %llu not\n",
+          pool->name, pool->zeroed_cnt, pool->zero_hits, pool->zero_misses);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
+  /* We'll put the pool's used_map, lent_map, and orders array at
+     its base.  Calculate the space needed for them and subtract
+     it from the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t meta_pages = DIV_ROUND_UP (2 * bm_size + page_cnt, PGSIZE);
+  int order;
+
+  if (meta_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  page_cnt -= meta_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  spinlock_init (&p->lock);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->lent_map = bitmap_create_in_buf (page_cnt, (uint8_t *) base + bm_size,
+                                      bm_size);
+  p->orders = (uint8_t *) base + 2 * bm_size;
+  memset (p->orders, NOT_FREE, page_cnt);
+  p->base = (uint8_t *) base + meta_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+  p->free_pages = 0;
+  p->name = name;
+  p->borrower = NULL;
+  p->lent = p->loan = 0;
+  p->low_wm = page_cnt / 16;
+  p->high_wm = page_cnt / 8;
+  p->grant_cnt = p->reclaim_cnt = p->borrow_fails = 0;
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->zero_hits = p->zero_misses = 0;
+
+  /* Everything starts out free. */
+  spinlock_acquire (&p->lock);
+  free_range (p, 0, page_cnt);
+  spinlock_release (&p->lock);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +769,7 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
@@ -0,0 +1,281 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab is one page, with this header at its start followed by
+   as many objects as fit.  A slab is on exactly one of its
+   cache's lists: `full' if all its objects are allocated,
+   `empty' if none are, `partial' otherwise.  Allocation prefers
+   partial slabs, to keep the number of slabs in use low.
+
+   Free objects in a slab are chained through a pointer stored
+   in the object itself, at offset 0 if the cache has no
+   constructor.  Otherwise the pointer is stored just past the
+   object, so that it does not disturb the constructed state. */
+struct slab
+  {
+    struct kmem_cache *cache;   /* Owning cache. */
+    unsigned magic;             /* Detects bad pointers. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    size_t in_use;              /* Number of objects allocated. */
+    void *free;                 /* First free object. */
+  };
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Object alignment. */
+#define SLAB_ALIGN 8
+
+/* Offset of the first object in a slab. */
+#define SLAB_OBJ_OFS ROUND_UP (sizeof (struct slab), SLAB_ALIGN)
+
+/* Empty slabs kept per cache rather than returned to palloc. */
+#define SLAB_EMPTY_MAX 1
+
+/* A cache of objects of one size. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size requested by the creator. */
+    size_t slot_size;           /* Bytes per object in a slab. */
+    size_t link_ofs;            /* Offset of free-list link in object. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or a null pointer. */
+
+    struct lock lock;           /* Protects everything below. */
+    struct list partial;        /* Slabs with some objects allocated. */
+    struct list full;           /* Slabs with all objects allocated. */
+    struct list empty;          /* Slabs with no objects allocated. */
+    size_t empty_cnt;           /* Number of slabs in `empty'. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs, that is, pages, in use. */
+    size_t in_use;              /* Objects allocated. */
+    size_t max_in_use;          /* Most objects ever allocated at once. */
+    unsigned long long alloc_cnt; /* Calls to kmem_cache_alloc(). */
+
+    struct list_elem elem;      /* Element in `caches'. */
+  };
+
+/* All caches, for statistics. */
+static struct list caches = LIST_INITIALIZER (caches);
+
+static struct slab *slab_create (struct kmem_cache *);
+static void **obj_link (struct kmem_cache *, void *obj);
+
+/* Creates and returns a cache for objects of SIZE bytes, named
+   NAME.  If CTOR is non-null, it is called to construct each
+   object when its slab is created.  NAME must remain valid for
+   as long as the cache.
+
+   Caches are created at initialization time and never
+   destroyed, so failure to create one is a kernel panic. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("%s: failed to allocate slab cache", name);
+
+  c->name = name;
+  c->obj_size = size;
+  size = ROUND_UP (size, SLAB_ALIGN);
+  if (ctor != NULL)
+    {
+      c->link_ofs = size;
+      c->slot_size = size + SLAB_ALIGN;
+    }
+  else
+    {
+      c->link_ofs = 0;
+      c->slot_size = size;
+    }
+  c->objs_per_slab = (PGSIZE - SLAB_OBJ_OFS) / c->slot_size;
+  if (c->objs_per_slab == 0)
+    PANIC ("%s: %zu-byte objects are too big for a slab", name, size);
+  c->ctor = ctor;
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+  c->slab_cnt = c->in_use = c->max_in_use = 0;
+  c->alloc_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&caches, &c->elem);
+  intr_set_level (old_level);
+
+  return c;
+}
+
+/* Allocates and returns an object from cache C, or returns a
+   null pointer if no memory is available.  The object is not
+   zeroed; if C has a constructor, the object is in its
+   constructed state. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (c != NULL);
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      if (!list_empty (&c->empty))
+        {
+          s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+          c->empty_cnt--;
+        }
+      else
+        {
+          s = slab_create (c);
+          if (s == NULL)
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  obj = s->free;
+  s->free = *obj_link (c, obj);
+  if (++s->in_use == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->max_in_use)
+    c->max_in_use = c->in_use;
+  lock_release (&c->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C.  If OBJ is a null pointer, does nothing. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+
+  ASSERT (c != NULL);
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT (((uint8_t *) obj - (uint8_t *) s - SLAB_OBJ_OFS)
+          % c->slot_size == 0);
+
+  lock_acquire (&c->lock);
+  *obj_link (c, obj) = s->free;
+  s->free = obj;
+  c->in_use--;
+
+  if (s->in_use-- == c->objs_per_slab)
+    {
+      /* Was full, now partial (or empty, below). */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  if (s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (c->empty_cnt < SLAB_EMPTY_MAX)
+        {
+          list_push_front (&c->empty, &s->elem);
+          c->empty_cnt++;
+        }
+      else
+        {
+          s->magic = 0;
+          palloc_free_page (s);
+          c->slab_cnt--;
+        }
+    }
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for each slab cache. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+
+      printf ("Slab %s: %zu-byte objects, %zu in use (max %zu), "
+              "%llu allocs, %zu slabs (%zu partial, %zu full, %zu empty)\n",
+              c->name, c->obj_size, c->in_use, c->max_in_use, c->alloc_cnt,
+              c->slab_cnt, list_size (&c->partial), list_size (&c->full),
+              c->empty_cnt);
+    }
+}
+
+/* Allocates a new slab for cache C, with all of its objects
+   free and constructed.  Returns the slab, or a null pointer if
+   no memory is available. */
+static struct slab *
+slab_create (struct kmem_cache *c)
+{
+  struct slab *s;
+  uint8_t *obj;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->cache = c;
+  s->magic = SLAB_MAGIC;
+  s->in_use = 0;
+  s->free = NULL;
+
+  /* Chain the objects so that the first is allocated first. */
+  obj = (uint8_t *) s + SLAB_OBJ_OFS + (c->objs_per_slab - 1) * c->slot_size;
+  for (i = 0; i < c->objs_per_slab; i++, obj -= c->slot_size)
+    {
+      if (c->ctor != NULL)
+        c->ctor (obj);
+      *obj_link (c, obj) = s->free;
+      s->free = obj;
+    }
+
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the location of OBJ's free-list link. */
+static void **
+obj_link (struct kmem_cache *c, void *obj)
+{
+  return (void **) ((uint8_t *) obj + c->link_ofs);
+}
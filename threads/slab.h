@@ -0,0 +1,26 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Slab allocator for fixed-size kernel objects.
+
+   A cache hands out objects of a single size, carved out of
+   page-sized slabs, so that objects of one type are packed
+   densely instead of being rounded up to a power of two by
+   malloc().  See slab.c for details. */
+
+struct kmem_cache;
+
+/* Object constructor.  Called once for each object when its slab
+   is created, not on every allocation; objects must be returned
+   to the cache in their constructed state. */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
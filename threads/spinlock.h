@@ -0,0 +1,83 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* A spinlock.
+
+   Turning interrupts off is enough to keep other threads away
+   from shared data on a single CPU, but not from code running on
+   another CPU.  A spinlock does both: it turns interrupts off on
+   the local CPU, then busy-waits until no other CPU holds it.
+   It must be held only briefly and the holder must not sleep.
+
+   Unlike a lock from synch.h, a spinlock may be acquired in an
+   interrupt handler. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* Nonzero while held. */
+    enum intr_level old_level;  /* Interrupt level before acquire. */
+  };
+
+/* Atomically sets *P to 1 and returns its old value. */
+static inline uint32_t
+spinlock_xchg (volatile uint32_t *p)
+{
+  uint32_t old = 1;
+  asm volatile ("lock xchgl %0, %1" : "+r" (old), "+m" (*p) : : "memory");
+  return old;
+}
+
+/* Initializes spinlock L. */
+static inline void
+spinlock_init (struct spinlock *l)
+{
+  l->locked = 0;
+}
+
+/* Acquires spinlock L, turning interrupts off first and spinning
+   until L is free. */
+static inline void
+spinlock_acquire (struct spinlock *l)
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (spinlock_xchg (&l->locked))
+    while (l->locked)
+      asm volatile ("pause");
+  l->old_level = old_level;
+}
+
+/* Tries to acquire spinlock L without spinning.  Returns true if
+   successful, in which case interrupts are off until L is
+   released, or false if L is held. */
+static inline bool
+spinlock_try_acquire (struct spinlock *l)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (spinlock_xchg (&l->locked))
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  l->old_level = old_level;
+  return true;
+}
+
+/* Releases spinlock L and restores the interrupt level from
+   before it was acquired. */
+static inline void
+spinlock_release (struct spinlock *l)
+{
+  enum intr_level old_level = l->old_level;
+
+  ASSERT (l->locked);
+  asm volatile ("movl $0, %0" : "=m" (l->locked) : : "memory");
+  intr_set_level (old_level);
+}
+
+#endif /* threads/spinlock.h */
@@ -29,9 +29,26 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* Maximum length of a chain of locks through which a priority
+   is donated.  Bounds the work done by lock_acquire() and keeps
+   a (buggy) cycle of waiting threads from looping forever. */
+#define DONATION_DEPTH_MAX 8
+
+#ifdef LOCK_PROFILE
+/* List of locks initialized with lock_init_named(). */
+static struct list named_locks = LIST_INITIALIZER (named_locks);
+#endif
+
+static void donate_priority (struct lock *);
+static int sema_waiters_max_priority (const struct semaphore *);
+static struct thread *waiters_max (struct list *);
+static bool rwlock_reader_waits (const struct rwlock *);
+static void rwlock_wake (struct rwlock *);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -68,7 +85,11 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      struct thread *cur = thread_current ();
+
+      cur->wait_sema = sema;
+      list_insert_ordered (&sema->waiters, &cur->elem,
+                           thread_priority_more, NULL);
       thread_block ();
     }
   sema->value--;
@@ -102,7 +123,11 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  The waiters are kept in priority order, so this
+   takes constant time.  If the woken thread outranks the current
+   one, the current thread yields, unless the caller turned
+   interrupts off.
 
    This function may be called from an interrupt handler. */
 void
@@ -114,10 +139,30 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      struct thread *t = list_entry (list_pop_front (&sema->waiters),
+                                     struct thread, elem);
+      t->wait_sema = NULL;
+      thread_unblock (t);
+    }
   sema->value++;
   intr_set_level (old_level);
+  if (old_level == INTR_ON || intr_context ())
+    thread_preempt ();
+}
+
+/* Returns the highest priority among the threads waiting on
+   SEMA, or PRI_MIN if there are none.  Must be called with
+   interrupts off. */
+static int
+sema_waiters_max_priority (const struct semaphore *sema)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty ((struct list *) &sema->waiters))
+    return PRI_MIN;
+  return list_entry (list_front ((struct list *) &sema->waiters),
+                     struct thread, elem)->priority;
 }
 
 static void sema_test_helper (void *sema_);
@@ -178,13 +223,55 @@ lock_init (struct lock *lock)
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
+  lock->priority = PRI_MIN;
+#ifdef LOCK_PROFILE
+  lock->name = NULL;
+#endif
   sema_init (&lock->semaphore, 1);
 }
 
+/* Initializes LOCK, like lock_init(), and also keeps statistics
+   on how often it is contended and for how long, under the given
+   NAME.  The statistics are printed by lock_print_stats().
+
+   Statistics are only kept if the kernel is built with
+   LOCK_PROFILE defined (for example, by adding -DLOCK_PROFILE to
+   DEFINES in Make.vars), because timing every acquire and
+   release reads the PIT.  Otherwise this is the same as
+   lock_init().
+
+   Only a lock that is never freed may be named, and NAME must
+   remain valid for as long as the lock.  Named locks are meant
+   for long-lived kernel locks whose contention is of interest. */
+void
+lock_init_named (struct lock *lock, const char *name)
+{
+#ifdef LOCK_PROFILE
+  enum intr_level old_level;
+#endif
+
+  ASSERT (name != NULL);
+
+  lock_init (lock);
+#ifdef LOCK_PROFILE
+  lock->name = name;
+  memset (&lock->stats, 0, sizeof lock->stats);
+  lock->acquire_time = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&named_locks, &lock->named_elem);
+  intr_set_level (old_level);
+#endif
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
 
+   If the lock is held, the current thread donates its priority
+   to the holder, and on through the chain of locks the holder
+   is itself waiting for, up to DONATION_DEPTH_MAX locks deep.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -192,12 +279,77 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool contended;
+#ifdef LOCK_PROFILE
+  int64_t wait_start = 0;
+#endif
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  contended = lock->holder != NULL;
+#ifdef LOCK_PROFILE
+  if (lock->name != NULL && contended)
+    wait_start = timer_cycles ();
+#endif
+  if (contended && !thread_mlfqs)
+    {
+      cur->wait_lock = lock;
+      donate_priority (lock);
+    }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  cur->wait_lock = NULL;
+  lock->holder = cur;
+  lock->priority = sema_waiters_max_priority (&lock->semaphore);
+  list_push_back (&cur->held_locks, &lock->elem);
+#ifdef LOCK_PROFILE
+  if (lock->name != NULL)
+    {
+      struct lock_stats *s = &lock->stats;
+
+      lock->acquire_time = timer_cycles ();
+      s->acquire_cnt++;
+      if (contended)
+        {
+          int64_t wait = lock->acquire_time - wait_start;
+
+          s->contend_cnt++;
+          s->wait_time += wait;
+          if (wait > s->max_wait_time)
+            s->max_wait_time = wait;
+        }
+    }
+#endif
+  intr_set_level (old_level);
+}
+
+/* Donates the current thread's priority to the holder of LOCK,
+   and transitively to the holders of the locks that holder is
+   waiting on.  Must be called with interrupts off. */
+static void
+donate_priority (struct lock *lock)
+{
+  int priority = thread_current ()->priority;
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; lock != NULL && depth < DONATION_DEPTH_MAX; depth++)
+    {
+      struct thread *holder = lock->holder;
+
+      /* Stop once the chain already carries this priority. */
+      if (holder == NULL || lock->priority >= priority)
+        break;
+      lock->priority = priority;
+      if (holder->priority < priority)
+        thread_update_priority (holder);
+      lock = holder->wait_lock;
+    }
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -209,18 +361,35 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+      lock->priority = sema_waiters_max_priority (&lock->semaphore);
+      list_push_back (&lock->holder->held_locks, &lock->elem);
+#ifdef LOCK_PROFILE
+      if (lock->name != NULL)
+        {
+          lock->acquire_time = timer_cycles ();
+          lock->stats.acquire_cnt++;
+        }
+#endif
+    }
+  intr_set_level (old_level);
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
+   Any priority donated through LOCK is given up, and the current
+   thread yields if that leaves a ready thread with a higher
+   priority.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -228,11 +397,29 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+#ifdef LOCK_PROFILE
+  if (lock->name != NULL)
+    {
+      int64_t hold = timer_cycles () - lock->acquire_time;
+      if (hold > lock->stats.max_hold_time)
+        lock->stats.max_hold_time = hold;
+    }
+#endif
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  lock->priority = PRI_MIN;
+  if (!thread_mlfqs)
+    thread_update_priority (cur);
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
+  thread_preempt ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -245,14 +432,316 @@ lock_held_by_current_thread (const struct lock *lock)
 
   return lock->holder == thread_current ();
 }
+
+/* Copies the statistics for the named lock called NAME into
+   *STATS and returns true, or returns false if there is no such
+   lock or the kernel was built without LOCK_PROFILE.  If more
+   than one lock has that NAME, the first one initialized is
+   used. */
+bool
+lock_get_stats (const char *name, struct lock_stats *stats)
+{
+#ifdef LOCK_PROFILE
+  enum intr_level old_level;
+  struct list_elem *e;
+  bool found = false;
+
+  ASSERT (name != NULL);
+  ASSERT (stats != NULL);
+
+  old_level = intr_disable ();
+  for (e = list_begin (&named_locks); e != list_end (&named_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, named_elem);
+      if (!strcmp (lock->name, name))
+        {
+          *stats = lock->stats;
+          found = true;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+  return found;
+#else
+  ASSERT (name != NULL);
+  ASSERT (stats != NULL);
+
+  return false;
+#endif
+}
+
+/* Prints contention statistics for each named lock that has been
+   acquired at least once, if the kernel was built with
+   LOCK_PROFILE. */
+void
+lock_print_stats (void)
+{
+#ifdef LOCK_PROFILE
+  struct list_elem *e;
+
+  for (e = list_begin (&named_locks); e != list_end (&named_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, named_elem);
+      struct lock_stats s = lock->stats;
+
+      if (s.acquire_cnt == 0)
+        continue;
+      printf ("Lock %s: %llu acquires, %llu contended, "
+              "%lld us waiting (max %lld us), max hold %lld us\n",
+              lock->name, s.acquire_cnt, s.contend_cnt,
+              timer_cycles_to_us (s.wait_time), timer_cycles_to_us (s.max_wait_time),
+              timer_cycles_to_us (s.max_hold_time));
+    }
+#endif
+}
+
+/* Initializes RW.  A readers-writer lock may be held by any
+   number of readers at once, or by a single writer.  Like a lock,
+   it is not recursive, and the thread that acquires it must be
+   the one to release it.
+
+   Waiting writers are preferred over new readers, so that a
+   steady stream of readers cannot starve a writer.  If PRIO is
+   true, a reader is allowed past the waiting writers if it
+   outranks all of them, and waiting writers are let through in
+   priority order rather than first-come, first-served.
+
+   Unlike a lock, a readers-writer lock does not donate priority
+   to its holders. */
+void
+rwlock_init (struct rwlock *rw, bool prio)
+{
+  ASSERT (rw != NULL);
+
+  rw->readers = 0;
+  rw->writer = NULL;
+  rw->writers_waiting = 0;
+  list_init (&rw->read_waiters);
+  list_init (&rw->write_waiters);
+  rw->prio = prio;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it or
+   is waiting for it, if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  while (rwlock_reader_waits (rw))
+    {
+      list_push_back (&rw->read_waiters, &thread_current ()->elem);
+      thread_block ();
+    }
+  rw->readers++;
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for reading and returns true if successful
+   or false if the current thread would have to wait.
+
+   This function will not sleep, so it may be called within an
+   interrupt handler. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = !rwlock_reader_waits (rw);
+  if (success)
+    rw->readers++;
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   The last reader out wakes the waiting writers or readers. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0)
+    rwlock_wake (rw);
+  intr_set_level (old_level);
+  thread_preempt ();
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it, if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  rw->writers_waiting++;
+  while (rw->writer != NULL || rw->readers > 0)
+    {
+      list_push_back (&rw->write_waiters, &thread_current ()->elem);
+      thread_block ();
+    }
+  rw->writers_waiting--;
+  rw->writer = thread_current ();
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing and returns true if successful
+   or false if the current thread would have to wait.
+
+   This function will not sleep, so it may be called within an
+   interrupt handler. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = rw->writer == NULL && rw->readers == 0;
+  if (success)
+    rw->writer = thread_current ();
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for writing,
+   and wakes the waiting writers or readers. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  rw->writer = NULL;
+  rwlock_wake (rw);
+  intr_set_level (old_level);
+  thread_preempt ();
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise.  There is no way to test for holding it for reading,
+   because readers are not recorded individually. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Returns true if a thread that wants to read RW must wait.
+   Must be called with interrupts off. */
+static bool
+rwlock_reader_waits (const struct rwlock *rw)
+{
+  struct thread *w;
+
+  if (rw->writer != NULL)
+    return true;
+  if (rw->writers_waiting == 0)
+    return false;
+  if (!rw->prio)
+    return true;
+
+  /* A reader may overtake waiting writers that it outranks. */
+  w = waiters_max ((struct list *) &rw->write_waiters);
+  return w == NULL || w->priority >= thread_current ()->priority;
+}
+
+/* Wakes the next thread or threads to take RW, which has just
+   become free: one waiting writer if there is one, otherwise all
+   the waiting readers.  With priority enabled, readers are woken
+   instead if one of them outranks every waiting writer.  Must be
+   called with interrupts off. */
+static void
+rwlock_wake (struct rwlock *rw)
+{
+  struct thread *writer = NULL;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!list_empty (&rw->write_waiters))
+    {
+      writer = (rw->prio
+                ? waiters_max (&rw->write_waiters)
+                : list_entry (list_front (&rw->write_waiters),
+                              struct thread, elem));
+      if (rw->prio && !list_empty (&rw->read_waiters)
+          && waiters_max (&rw->read_waiters)->priority > writer->priority)
+        writer = NULL;
+    }
+
+  if (writer != NULL)
+    {
+      list_remove (&writer->elem);
+      thread_unblock (writer);
+    }
+  else
+    while (!list_empty (&rw->read_waiters))
+      thread_unblock (list_entry (list_pop_front (&rw->read_waiters),
+                                  struct thread, elem));
+}
+
+/* Returns the highest-priority thread in WAITERS, the earliest
+   among equals, or a null pointer if WAITERS is empty.  Must be
+   called with interrupts off. */
+static struct thread *
+waiters_max (struct list *waiters)
+{
+  struct thread *max = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (waiters); e != list_end (waiters); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, elem);
+      if (max == NULL || t->priority > max->priority)
+        max = t;
+    }
+  return max;
+}
 
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    int priority;                       /* Waiting thread's priority. */
   };
 
+static bool semaphore_elem_more (const struct list_elem *,
+                                 const struct list_elem *, void *aux);
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -295,14 +784,17 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.priority = thread_current ()->priority;
+  list_insert_ordered (&cond->waiters, &waiter.elem,
+                       semaphore_elem_more, NULL);
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
+   this function signals the one with the highest priority, as of
+   when it began waiting, to wake up from its wait.
    LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -336,3 +828,17 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Returns true if the thread waiting on semaphore_elem A_ has a
+   higher priority than the one waiting on B_. */
+static bool
+semaphore_elem_more (const struct list_elem *a_, const struct list_elem *b_,
+                     void *aux UNUSED)
+{
+  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem,
+                                               elem);
+
+  return a->priority > b->priority;
+}
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -17,18 +18,63 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Contention statistics for a named lock, kept only if the
+   kernel is built with LOCK_PROFILE defined.  Times are in PIT
+   cycles. */
+struct lock_stats
+  {
+    unsigned long long acquire_cnt;     /* Times acquired. */
+    unsigned long long contend_cnt;     /* Times acquired after waiting. */
+    int64_t wait_time;                  /* Total time spent waiting. */
+    int64_t max_wait_time;              /* Longest wait. */
+    int64_t max_hold_time;              /* Longest time held. */
+  };
+
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    int priority;               /* Highest priority donated by waiters. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
+
+#ifdef LOCK_PROFILE
+    /* Profiling, for locks initialized with lock_init_named(). */
+    const char *name;           /* Name, or a null pointer. */
+    struct list_elem named_elem; /* Element in list of named locks. */
+    struct lock_stats stats;    /* Contention statistics. */
+    int64_t acquire_time;       /* When last acquired. */
+#endif
   };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+bool lock_get_stats (const char *name, struct lock_stats *);
+void lock_print_stats (void);
+
+/* Readers-writer lock. */
+struct rwlock
+  {
+    unsigned readers;           /* Number of threads reading. */
+    struct thread *writer;      /* Thread writing, if any. */
+    unsigned writers_waiting;   /* Writers waiting or being woken. */
+    struct list read_waiters;   /* Readers waiting. */
+    struct list write_waiters;  /* Writers waiting. */
+    bool prio;                  /* Let waiters through by priority? */
+  };
+
+void rwlock_init (struct rwlock *, bool prio);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
 
 /* Condition variable. */
 struct condition 
@@ -2,12 +2,15 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -22,9 +25,17 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue: one list per priority level of processes in
+   THREAD_READY state, that is, processes that are ready to run
+   but not actually running.  Bit P of ready_mask is set if and
+   only if ready_queues[P] is nonempty, so that the highest ready
+   priority can be found without scanning the queues. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+#define READY_MASK_BITS 32
+#define READY_MASK_CNT DIV_ROUND_UP (PRI_CNT, READY_MASK_BITS)
+static struct list ready_queues[PRI_CNT];
+static uint32_t ready_mask[READY_MASK_CNT];
+static size_t ready_cnt;        /* # of threads in ready_queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -39,6 +50,19 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Pages of dead threads, kept for reuse by thread_create() to
+   spare it a trip through the page allocator and the cost of
+   zeroing a whole page.  Linked through the dead threads'
+   `elem' members. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+static long long thread_cache_hits;     /* # of pages reused. */
+static long long thread_cache_misses;   /* # of pages from palloc. */
+
+/* Cache of child records. */
+static struct kmem_cache *child_cache;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -52,6 +76,10 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Scheduler statistics. */
+static struct sched_stats sched_stats;
+static bool preempting;         /* Is the running thread being preempted? */
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
@@ -61,6 +89,10 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler. */
+#define MLFQS_PRI_INTERVAL 4    /* Ticks between priority updates. */
+static fixed_t load_avg;        /* System load average. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -72,6 +104,23 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *alloc_thread (void);
+static void free_thread (struct thread *);
+static struct child *alloc_child (void);
+static void free_child (struct child *);
+static void release_child (struct child *);
+static hash_hash_func child_hash;
+static hash_less_func child_less;
+static hash_action_func orphan_child;
+static void hist_add (struct sched_hist *, unsigned value);
+static void hist_print (const char *name, const struct sched_hist *);
+static void ready_queue_push (struct thread *);
+static struct thread *ready_queue_pop (void);
+static int ready_queue_max_priority (void);
+static void ready_queue_remove (struct thread *);
+static void set_priority (struct thread *, int priority);
+static int mlfqs_priority (const struct thread *);
+static void mlfqs_update (void);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -89,11 +138,15 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
   list_init (&all_list);
+  list_init (&thread_cache);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -103,12 +156,16 @@ thread_init (void)
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
-   Also creates the idle thread. */
+   Also creates the idle thread and, since every thread has a
+   child record, the cache they are allocated from. */
 void
 thread_start (void) 
 {
-  /* Create the idle thread. */
   struct semaphore idle_started;
+
+  child_cache = kmem_cache_create ("child", sizeof (struct child), NULL);
+
+  /* Create the idle thread. */
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
@@ -120,21 +177,44 @@ thread_start (void)
 }
 
 /* Called by the timer interrupt handler at each timer tick.
+   USER is true if the tick interrupted user code.
    Thus, this function runs in an external interrupt context. */
 void
-thread_tick (void) 
+thread_tick (bool user) 
 {
   struct thread *t = thread_current ();
 
   /* Update statistics. */
   if (t == idle_thread)
     idle_ticks++;
-#ifdef USERPROG
-  else if (t->pagedir != NULL)
-    user_ticks++;
-#endif
+  else if (user)
+    {
+      user_ticks++;
+      t->usage.user_ticks++;
+    }
   else
-    kernel_ticks++;
+    {
+      kernel_ticks++;
+      t->usage.kernel_ticks++;
+    }
+  hist_add (&sched_stats.ready_depth, ready_cnt);
+
+  if (thread_mlfqs)
+    {
+      int64_t now = timer_ticks ();
+
+      /* Only the running thread's recent_cpu changes between
+         once-per-second updates, so it is the only thread whose
+         priority needs recomputing in between. */
+      if (t != idle_thread)
+        t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+      if (now % TIMER_FREQ == 0)
+        mlfqs_update ();
+      else if (now % MLFQS_PRI_INTERVAL == 0 && t != idle_thread)
+        t->priority = mlfqs_priority (t);
+      if (ready_queue_max_priority () > t->priority)
+        intr_yield_on_return ();
+    }
 
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
@@ -147,6 +227,74 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread cache: %lld hits, %lld misses\n",
+          thread_cache_hits, thread_cache_misses);
+  printf ("Scheduler: %lld voluntary, %lld involuntary context switches\n",
+          sched_stats.voluntary_switches, sched_stats.involuntary_switches);
+#ifdef SCHED_PROFILE
+  hist_print ("Wakeup latency (us)", &sched_stats.wakeup_latency);
+#endif
+  hist_print ("Run queue depth", &sched_stats.ready_depth);
+}
+
+/* Stores the running thread's own resource usage into *USAGE. */
+void
+thread_get_rusage (struct rusage *usage)
+{
+  enum intr_level old_level = intr_disable ();
+  *usage = thread_current ()->usage;
+  intr_set_level (old_level);
+}
+
+/* Adds the counts in B to those in A. */
+void
+rusage_add (struct rusage *a, const struct rusage *b)
+{
+  a->user_ticks += b->user_ticks;
+  a->kernel_ticks += b->kernel_ticks;
+  a->voluntary_switches += b->voluntary_switches;
+  a->involuntary_switches += b->involuntary_switches;
+  a->page_faults += b->page_faults;
+}
+
+/* Copies the scheduler's global statistics into *STATS. */
+void
+thread_get_sched_stats (struct sched_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = sched_stats;
+  intr_set_level (old_level);
+}
+
+/* Copies the wakeup latency histogram of the thread with the
+   given TID into *HIST, which is all zeros unless the kernel is
+   built with SCHED_PROFILE.  Returns false if there is no such
+   thread. */
+bool
+thread_get_wakeup_latency (tid_t tid, struct sched_hist *hist)
+{
+  struct list_elem *e;
+  bool found = false;
+  enum intr_level old_level;
+
+  memset (hist, 0, sizeof *hist);
+  old_level = intr_disable ();
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      if (t->tid == tid)
+        {
+#ifdef SCHED_PROFILE
+          *hist = t->wakeup_latency;
+#endif
+          found = true;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+
+  return found;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -161,12 +309,13 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, the running thread yields to it immediately. */
 tid_t thread_create (const char *name, int priority, thread_func *function, void *aux) {
 
+    struct thread *cur = thread_current ();
     struct thread *t;
+    struct child *child_ptr;
     struct kernel_thread_frame *kf;
     struct switch_entry_frame *ef;
     struct switch_threads_frame *sf;
@@ -174,10 +323,25 @@ tid_t thread_create (const char *name, int priority, thread_func *function, void
 
     ASSERT (function != NULL);
 
-    /* Allocate thread. */
-    t = palloc_get_page (PAL_ZERO);
+    /* The table of children is set up on first use, so that
+       threads without children do not pay for it. */
+    if (!cur->children_init)
+      {
+        if (!hash_init (&cur->children, child_hash, child_less, NULL))
+          return TID_ERROR;
+        cur->children_init = true;
+      }
+
+    /* Allocate thread and its child record. */
+    t = alloc_thread ();
     if (t == NULL)
-    return TID_ERROR;
+      return TID_ERROR;
+    child_ptr = alloc_child ();
+    if (child_ptr == NULL)
+      {
+        free_thread (t);
+        return TID_ERROR;
+      }
 
     /* Initialize thread. */
     init_thread (t, name, priority);
@@ -198,17 +362,23 @@ tid_t thread_create (const char *name, int priority, thread_func *function, void
     sf->eip = switch_entry;
     sf->ebp = 0;
 
-    /* add child to child_list*/
-    struct child* child_ptr = malloc(sizeof(struct child));
+    /* add child to the parent's table of children */
     child_ptr->tid = t->tid;
+    child_ptr->ref_cnt = 2;
     child_ptr->exiting = false;
+    child_ptr->waited = false;
+    sema_init (&child_ptr->load_done, 0);
     child_ptr->load_status = 0;
-    
-    list_push_back(&thread_current()->child_list, &child_ptr->elem);
+    sema_init (&child_ptr->exit_done, 0);
+    child_ptr->exit_status = -1;
+    memset (&child_ptr->usage, 0, sizeof child_ptr->usage);
+
+    hash_insert (&cur->children, &child_ptr->elem);
     t->c = child_ptr;
 
     /* Add to run queue. */
     thread_unblock (t);
+    thread_preempt ();
 
     return tid;
 }
@@ -246,7 +416,10 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+#ifdef SCHED_PROFILE
+  t->wakeup_time = timer_cycles ();
+#endif
+  ready_queue_push (t);
   t->status = THREAD_READY;
   intr_set_level (old_level);
 }
@@ -289,31 +462,35 @@ thread_tid (void)
 void
 thread_exit (void) 
 {
+  struct thread *cur = thread_current ();
+
   ASSERT (!intr_context ());
 
 #ifdef USERPROG
   process_exit ();
 #endif
 
+  /* Report our usage to our parent and wake it if it is waiting
+     for us, then let go of the records of our own children. */
+  if (cur->c != NULL)
+    {
+      cur->c->usage = cur->usage;
+      rusage_add (&cur->c->usage, &cur->children_usage);
+      cur->c->exiting = true;
+      sema_up (&cur->c->exit_done);
+      release_child (cur->c);
+      cur->c = NULL;
+    }
+  if (cur->children_init)
+    {
+      hash_destroy (&cur->children, orphan_child);
+      cur->children_init = false;
+    }
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
-    struct thread* cur=thread_current();
- /*   struct list_elem* e;
-    struct filehandle* fh;
-    for(e=list_begin(&cur->fd_list); e!= list_end(&cur->fd_list); e=list_next(e))
-    {
-        fh=list_entry(e,struct filehandle, elem);
-        file_close(fh->fp);
-        list_remove(e);
-    }
-*/
-/*
-    if(cur->myself != NULL){
-    file_close(cur->myself);
-    }
-*/
   list_remove (&thread_current()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
@@ -332,12 +509,39 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+    ready_queue_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU on behalf of an interrupt handler that called
+   intr_yield_on_return().  Unlike thread_yield(), the resulting
+   context switch is counted as involuntary. */
+void
+thread_yield_on_return (void)
+{
+  preempting = true;
+  thread_yield ();
+}
+
+/* Yields the CPU if some ready thread has a higher priority
+   than the running thread.  Within an interrupt handler, the
+   yield is deferred until the handler returns. */
+void
+thread_preempt (void)
+{
+  enum intr_level old_level = intr_disable ();
+  if (ready_queue_max_priority () > thread_current ()->priority)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
+  intr_set_level (old_level);
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -355,49 +559,151 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY.  Its
+   effective priority stays raised while it holds locks whose
+   waiters donate a higher one.  Yields if the running thread no
+   longer has the highest priority.  Ignored under the
+   multi-level feedback queue scheduler, which computes
+   priorities itself. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_update_priority (cur);
+  intr_set_level (old_level);
+  thread_preempt ();
+}
+
+/* Recomputes T's effective priority as the maximum of its base
+   priority and the priorities donated through the locks it
+   holds, moving T to the matching run queue if it is ready.
+   Does not preempt.  Must be called with interrupts off. */
+void
+thread_update_priority (struct thread *t)
+{
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      if (lock->priority > priority)
+        priority = lock->priority;
+    }
+  set_priority (t, priority);
 }
 
-/* Returns the current thread's priority. */
+/* Returns the current thread's effective priority. */
 int
 thread_get_priority (void) 
 {
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recalculates
+   its priority, yielding if it no longer has the highest
+   priority. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    cur->priority = mlfqs_priority (cur);
+  intr_set_level (old_level);
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent_cpu_100;
+}
+
+/* Returns the priority that the multi-level feedback queue
+   scheduler assigns to T, given its recent_cpu and nice. */
+static int
+mlfqs_priority (const struct thread *t)
+{
+  int priority = PRI_MAX - fp_to_int (t->recent_cpu / 4) - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  if (priority > PRI_MAX)
+    return PRI_MAX;
+  return priority;
+}
+
+/* Once-per-second update for the multi-level feedback queue
+   scheduler.  Recomputes the load average, then every thread's
+   recent_cpu and priority in a single pass over all_list, moving
+   ready threads whose priority changed to their new run queue.
+   Runs in the timer interrupt handler. */
+static void
+mlfqs_update (void)
+{
+  struct thread *cur = running_thread ();
+  int ready_threads = ready_cnt + (cur != idle_thread ? 1 : 0);
+  fixed_t decay;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  load_avg = (59 * load_avg + fp_from_int (ready_threads)) / 60;
+
+  /* recent_cpu decays by 2*load_avg / (2*load_avg + 1) each
+     second.  The factor is the same for every thread, so compute
+     it once. */
+  decay = fp_div (2 * load_avg, fp_add_int (2 * load_avg, 1));
+
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+
+      if (t == idle_thread)
+        continue;
+      t->recent_cpu = fp_add_int (fp_mul (decay, t->recent_cpu), t->nice);
+      set_priority (t, mlfqs_priority (t));
+    }
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -421,6 +727,7 @@ idle (void *idle_started_ UNUSED)
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
+      timer_idle_enter ();
 
       /* Re-enable interrupts and wait for the next one.
 
@@ -485,10 +792,19 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init (&t->held_locks);
+  if (t != initial_thread)
+    {
+      /* Inherit the creating thread's niceness and recent CPU. */
+      struct thread *parent = thread_current ();
+      t->nice = parent->nice;
+      t->recent_cpu = parent->recent_cpu;
+      if (thread_mlfqs)
+        t->priority = mlfqs_priority (t);
+    }
   t->magic = THREAD_MAGIC;
     t->fd_count=2;/*accounting for STDIN and STDOUT*/
-  list_init(&(t->childList));
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
@@ -498,8 +814,6 @@ init_thread (struct thread *t, const char *name, int priority)
   /* initialize file list*/ 
   list_init(&t->fd_list);
 
-  /* initialize child list */
-  list_init(&t->child_list);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -515,6 +829,108 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Adds T to the back of the run queue for its priority. */
+static void
+ready_queue_push (struct thread *t)
+{
+  int pri = t->priority - PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&ready_queues[pri], &t->elem);
+  ready_mask[pri / READY_MASK_BITS] |= 1u << (pri % READY_MASK_BITS);
+  ready_cnt++;
+}
+
+/* Removes T, which must be ready, from the run queue. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  int pri = t->priority - PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[pri]))
+    ready_mask[pri / READY_MASK_BITS] &= ~(1u << (pri % READY_MASK_BITS));
+  ready_cnt--;
+}
+
+/* Sets T's priority to PRIORITY, moving T to the matching run
+   queue if it is ready, or to its new place among the waiters if
+   it is blocked on a semaphore.  Does not preempt. */
+static void
+set_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->priority == priority)
+    return;
+  if (t->status == THREAD_READY)
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else if (t->status == THREAD_BLOCKED && t->wait_sema != NULL)
+    {
+      list_remove (&t->elem);
+      t->priority = priority;
+      list_insert_ordered (&t->wait_sema->waiters, &t->elem,
+                           thread_priority_more, NULL);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Returns true if the thread with list element A_ has a higher
+   priority than the one with B_.  Inserting with this function
+   keeps a list in descending priority order and threads of equal
+   priority in FIFO order. */
+bool
+thread_priority_more (const struct list_elem *a_, const struct list_elem *b_,
+                      void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority > b->priority;
+}
+
+/* Returns the highest priority of any thread in the run queue,
+   or PRI_MIN - 1 if the run queue is empty. */
+static int
+ready_queue_max_priority (void)
+{
+  int i;
+
+  for (i = READY_MASK_CNT - 1; i >= 0; i--)
+    if (ready_mask[i] != 0)
+      return (PRI_MIN + i * READY_MASK_BITS
+              + (READY_MASK_BITS - 1) - __builtin_clz (ready_mask[i]));
+  return PRI_MIN - 1;
+}
+
+/* Removes and returns the frontmost thread of the highest
+   nonempty priority level in the run queue, which must not be
+   empty. */
+static struct thread *
+ready_queue_pop (void)
+{
+  int pri = ready_queue_max_priority () - PRI_MIN;
+  struct list *queue;
+  struct thread *t;
+
+  ASSERT (pri >= 0);
+
+  queue = &ready_queues[pri];
+  t = list_entry (list_front (queue), struct thread, elem);
+  ready_queue_remove (t);
+  return t;
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
@@ -523,10 +939,10 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  if (ready_cnt == 0)
     return idle_thread;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return ready_queue_pop ();
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -558,6 +974,22 @@ thread_schedule_tail (struct thread *prev)
   /* Start new time slice. */
   thread_ticks = 0;
 
+#ifdef SCHED_PROFILE
+  /* Record how long we waited to run after being woken. */
+  if (cur->wakeup_time != 0)
+    {
+      int64_t latency = timer_cycles_to_us (timer_cycles ()
+                                            - cur->wakeup_time);
+      hist_add (&cur->wakeup_latency, latency);
+      hist_add (&sched_stats.wakeup_latency, latency);
+      cur->wakeup_time = 0;
+    }
+#endif
+
+  /* Resume regular timer ticks if we were idle. */
+  if (prev != NULL && prev == idle_thread)
+    timer_idle_exit ();
+
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
@@ -571,7 +1003,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      free_thread (prev);
     }
 }
 
@@ -593,11 +1025,178 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  if (cur != next)
+    {
+      if (preempting)
+        {
+          cur->usage.involuntary_switches++;
+          sched_stats.involuntary_switches++;
+        }
+      else
+        {
+          cur->usage.voluntary_switches++;
+          sched_stats.voluntary_switches++;
+        }
+    }
+  preempting = false;
+
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
 }
 
+/* Returns a page for a new thread, reusing a dead thread's page
+   if one is cached, or a null pointer if no memory is available.
+   Only the `struct thread' at the bottom of the page is cleared,
+   by init_thread(); the stack above it need not be. */
+static struct thread *
+alloc_thread (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (thread_cache_cnt > 0)
+    {
+      t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+      thread_cache_cnt--;
+      thread_cache_hits++;
+    }
+  else
+    thread_cache_misses++;
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (0);
+  return t;
+}
+
+/* Releases the page of dead thread T, keeping it in the cache
+   if there is room. */
+static void
+free_thread (struct thread *t)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    {
+      list_push_front (&thread_cache, &t->elem);
+      thread_cache_cnt++;
+      t = NULL;
+    }
+  intr_set_level (old_level);
+
+  if (t != NULL)
+    palloc_free_page (t);
+}
+
+/* Returns a new child record, or a null pointer if no memory is
+   available. */
+static struct child *
+alloc_child (void)
+{
+  return kmem_cache_alloc (child_cache);
+}
+
+/* Frees child record C, which must not be in any table. */
+static void
+free_child (struct child *c)
+{
+  kmem_cache_free (child_cache, c);
+}
+
+/* Drops one reference to child record C, freeing it if that was
+   the last. */
+static void
+release_child (struct child *c)
+{
+  enum intr_level old_level;
+  bool last;
+
+  old_level = intr_disable ();
+  ASSERT (c->ref_cnt > 0);
+  last = --c->ref_cnt == 0;
+  intr_set_level (old_level);
+
+  if (last)
+    free_child (c);
+}
+
+/* Returns the running thread's record of its child TID, or a
+   null pointer if TID is not a child of the running thread.
+   Records are kept after the child has been waited for, until
+   the running thread exits. */
+struct child *
+thread_get_child (tid_t tid)
+{
+  struct thread *cur = thread_current ();
+  struct child key;
+  struct hash_elem *e;
+
+  if (!cur->children_init)
+    return NULL;
+  key.tid = tid;
+  e = hash_find (&cur->children, &key.elem);
+  return e != NULL ? hash_entry (e, struct child, elem) : NULL;
+}
+
+/* Returns a hash value for child record E. */
+static unsigned
+child_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct child, elem)->tid);
+}
+
+/* Returns true if child record A_ precedes B_. */
+static bool
+child_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct child *a = hash_entry (a_, struct child, elem);
+  const struct child *b = hash_entry (b_, struct child, elem);
+
+  return a->tid < b->tid;
+}
+
+/* Releases an exiting parent's reference to child record E. */
+static void
+orphan_child (struct hash_elem *e, void *aux UNUSED)
+{
+  release_child (hash_entry (e, struct child, elem));
+}
+
+/* Adds VALUE to histogram H. */
+static void
+hist_add (struct sched_hist *h, unsigned value)
+{
+  int bucket = value == 0 ? 0 : 32 - __builtin_clz (value);
+
+  if (bucket >= SCHED_HIST_BUCKETS)
+    bucket = SCHED_HIST_BUCKETS - 1;
+  h->cnt[bucket]++;
+}
+
+/* Prints the nonempty buckets of histogram H, labeled NAME. */
+static void
+hist_print (const char *name, const struct sched_hist *h)
+{
+  int i;
+
+  printf ("%s:", name);
+  for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+    if (h->cnt[i] != 0)
+      {
+        if (i == 0)
+          printf (" 0: %u", h->cnt[i]);
+        else if (i < SCHED_HIST_BUCKETS - 1)
+          printf (" <%u: %u", 1u << i, h->cnt[i]);
+        else
+          printf (" >=%u: %u", 1u << (i - 1), h->cnt[i]);
+      }
+  printf ("\n");
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
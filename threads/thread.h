@@ -2,8 +2,12 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
+#include <rusage.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
+#include "threads/synch.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -25,6 +29,32 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the multi-level feedback queue scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
+/* Histogram with power-of-two buckets.  Bucket 0 counts zero
+   values and bucket B > 0 counts values in [2**(B-1), 2**B),
+   except that the last bucket also counts all larger values. */
+#define SCHED_HIST_BUCKETS 16
+struct sched_hist
+  {
+    unsigned cnt[SCHED_HIST_BUCKETS];
+  };
+
+/* Scheduler statistics.  Wakeup latency, here and per thread, is
+   measured only if the kernel is built with SCHED_PROFILE
+   defined, because it takes a PIT read on every wakeup and every
+   switch. */
+struct sched_stats
+  {
+    struct sched_hist wakeup_latency;   /* Wakeup-to-run time, in us. */
+    struct sched_hist ready_depth;      /* Run queue length, per tick. */
+    long long voluntary_switches;       /* Switches on block or yield. */
+    long long involuntary_switches;     /* Switches on preemption. */
+  };
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -82,12 +112,20 @@ typedef int tid_t;
    ready state is on the run queue, whereas only a thread in the
    blocked state is on a semaphore wait list. */
 
+/* A parent's record of one of its children.  It is shared by the
+   two and freed when both have released it: the child when it
+   exits, the parent when it waits for the child or exits. */
 struct child {
-    struct list_elem elem;
+    struct hash_elem elem;  /* Element in parent's children table. */
     tid_t tid;
+    int ref_cnt;            /* Number of parent and child still holding it. */
     bool exiting;
+    bool waited;            /* Parent has waited for the child. */
+    struct semaphore load_done; /* Upped once load_status is set. */
     int load_status;
+    struct semaphore exit_done; /* Upped once the child has exited. */
     int exit_status;
+    struct rusage usage;    /* Usage of child and its waited children. */
 };
 
 struct filehandle {
@@ -99,26 +137,45 @@ struct filehandle {
 struct thread
   {
     /* Owned by thread.c. */
-    struct list childList;
     struct file* myself;
     tid_t tid;                          /* Thread identifier. */
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority before donation. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *wait_lock;             /* Lock being waited on, if any. */
+    struct semaphore *wait_sema;        /* Semaphore being waited on. */
+    int nice;                           /* Niceness, for mlfqs. */
+    fixed_t recent_cpu;                 /* Recent CPU use, for mlfqs. */
     int fd_count;
     struct list_elem allelem;           /* List element for all threads list. */
 
+#ifdef SCHED_PROFILE
+    /* Scheduler statistics, owned by thread.c. */
+    int64_t wakeup_time;                /* When last unblocked, or 0. */
+    struct sched_hist wakeup_latency;   /* Wakeup-to-run time, in us. */
+#endif
+
+    /* Resource usage. */
+    struct rusage usage;                /* Used by this thread. */
+    struct rusage children_usage;       /* Used by waited-for children. */
+
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
-    
+#ifdef VM
+    struct hash pages;                  /* Supplemental page table. */
+    bool pages_init;                    /* Is `pages' initialized? */
+#endif
 #endif
 
-    struct list child_list;
+    struct hash children;               /* Child records, by tid. */
+    bool children_init;                 /* Is `children' initialized? */
     struct list fd_list;
 
     struct child* c;
@@ -134,8 +191,12 @@ extern bool thread_mlfqs;
 void thread_init (void);
 void thread_start (void);
 
-void thread_tick (void);
+void thread_tick (bool user);
 void thread_print_stats (void);
+void thread_get_sched_stats (struct sched_stats *);
+bool thread_get_wakeup_latency (tid_t, struct sched_hist *);
+void thread_get_rusage (struct rusage *);
+void rusage_add (struct rusage *, const struct rusage *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -148,7 +209,10 @@ tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
+struct child *thread_get_child (tid_t);
 void thread_yield (void);
+void thread_preempt (void);
+void thread_yield_on_return (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -156,6 +220,9 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *);
+bool thread_priority_more (const struct list_elem *,
+                           const struct list_elem *, void *aux);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
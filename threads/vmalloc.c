@@ -0,0 +1,192 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+
+/* The page tables that cover the vmalloc region are allocated
+   and installed in init_page_dir by vmalloc_init(), before any
+   process page directory is created.  Page directories are
+   created by copying init_page_dir, so every one of them shares
+   these page tables, and later changes to the mappings are seen
+   in all address spaces without touching each page directory.
+
+   Each allocation is followed by an unmapped guard page, so that
+   running off the end of a buffer faults instead of silently
+   corrupting its neighbor. */
+
+/* Page tables covering the region. */
+#define VMALLOC_PT_CNT (VMALLOC_PAGES * PGSIZE / PTSPAN)
+
+static uint32_t *page_tables[VMALLOC_PT_CNT];
+
+/* Virtual pages in use, including guard pages. */
+static struct bitmap *used_map;
+static char used_map_buf[VMALLOC_PAGES / 8 + 64];
+
+/* Protects used_map and the statistics. */
+static struct lock vmalloc_lock;
+
+/* Statistics. */
+static size_t mapped_pages;     /* Physical pages mapped. */
+static size_t max_mapped_pages; /* Most ever mapped at once. */
+static unsigned long long alloc_cnt; /* Successful calls to vmalloc(). */
+static unsigned long long fail_cnt;  /* Failed calls to vmalloc(). */
+
+static uint32_t *lookup_pte (const void *);
+static void unmap_pages (uint8_t *, size_t page_cnt);
+
+/* Sets up the vmalloc region.  Must be called after
+   paging_init() and before any user page directory is
+   created. */
+void
+vmalloc_init (void)
+{
+  size_t i;
+
+  ASSERT (VMALLOC_PAGES % (PTSPAN / PGSIZE) == 0);
+  ASSERT (pg_ofs (VMALLOC_START) == 0 && pt_no (VMALLOC_START) == 0);
+
+  for (i = 0; i < VMALLOC_PT_CNT; i++)
+    {
+      uint8_t *vaddr = VMALLOC_START + i * PTSPAN;
+
+      ASSERT (init_page_dir[pd_no (vaddr)] == 0);
+      page_tables[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      init_page_dir[pd_no (vaddr)] = pde_create (page_tables[i]);
+    }
+
+  used_map = bitmap_create_in_buf (VMALLOC_PAGES, used_map_buf,
+                                   sizeof used_map_buf);
+  ASSERT (used_map != NULL);
+  lock_init_named (&vmalloc_lock, "vmalloc");
+}
+
+/* Allocates PAGE_CNT pages that are contiguous in kernel virtual
+   memory, but not necessarily in physical memory, and returns
+   the first one.  FLAGS are interpreted as for
+   palloc_get_multiple(), except that PAL_USER is not allowed.
+   Returns a null pointer if there is not enough virtual address
+   space or memory, unless PAL_ASSERT is set, in which case the
+   kernel panics. */
+void *
+vmalloc (enum palloc_flags flags, size_t page_cnt)
+{
+  uint8_t *pages = NULL;
+  size_t start, i;
+
+  ASSERT (!(flags & PAL_USER));
+
+  if (page_cnt == 0)
+    return NULL;
+
+  /* Reserve virtual pages, plus a guard page. */
+  lock_acquire (&vmalloc_lock);
+  start = bitmap_scan_and_flip_next (used_map, page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+
+  if (start != BITMAP_ERROR)
+    {
+      pages = VMALLOC_START + start * PGSIZE;
+
+      /* Back them with physical pages. */
+      for (i = 0; i < page_cnt; i++)
+        {
+          void *kpage = palloc_get_page (flags & PAL_ZERO);
+          if (kpage == NULL)
+            break;
+          *lookup_pte (pages + i * PGSIZE) = pte_create_kernel (kpage, true);
+        }
+      if (i < page_cnt)
+        {
+          unmap_pages (pages, i);
+          lock_acquire (&vmalloc_lock);
+          bitmap_set_multiple (used_map, start, page_cnt + 1, false);
+          lock_release (&vmalloc_lock);
+          pages = NULL;
+        }
+    }
+
+  lock_acquire (&vmalloc_lock);
+  if (pages != NULL)
+    {
+      alloc_cnt++;
+      mapped_pages += page_cnt;
+      if (mapped_pages > max_mapped_pages)
+        max_mapped_pages = mapped_pages;
+    }
+  else
+    fail_cnt++;
+  lock_release (&vmalloc_lock);
+
+  if (pages == NULL && (flags & PAL_ASSERT))
+    PANIC ("vmalloc: out of pages");
+  return pages;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGES, which must have
+   been allocated by a single call to vmalloc(). */
+void
+vfree (void *pages, size_t page_cnt)
+{
+  size_t start;
+
+  if (pages == NULL || page_cnt == 0)
+    return;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (is_vmalloc_vaddr (pages));
+
+  start = pg_no (pages) - pg_no (VMALLOC_START);
+  unmap_pages (pages, page_cnt);
+
+  lock_acquire (&vmalloc_lock);
+  ASSERT (bitmap_all (used_map, start, page_cnt + 1));
+  bitmap_set_multiple (used_map, start, page_cnt + 1, false);
+  mapped_pages -= page_cnt;
+  lock_release (&vmalloc_lock);
+}
+
+/* Prints vmalloc statistics. */
+void
+vmalloc_print_stats (void)
+{
+  printf ("Vmalloc: %zu pages mapped (max %zu), "
+          "%llu allocations, %llu failed\n",
+          mapped_pages, max_mapped_pages, alloc_cnt, fail_cnt);
+}
+
+/* Returns the page table entry for VADDR, which must be in the
+   vmalloc region. */
+static uint32_t *
+lookup_pte (const void *vaddr)
+{
+  size_t idx = pg_no (vaddr) - pg_no (VMALLOC_START);
+
+  ASSERT (is_vmalloc_vaddr (vaddr));
+  return &page_tables[idx / (PTSPAN / PGSIZE)][pt_no (vaddr)];
+}
+
+/* Unmaps the PAGE_CNT pages starting at PAGES and frees the
+   physical pages behind them. */
+static void
+unmap_pages (uint8_t *pages, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint8_t *vaddr = pages + i * PGSIZE;
+      uint32_t *pte = lookup_pte (vaddr);
+
+      ASSERT (*pte & PTE_P);
+      palloc_free_page (pte_get_page (*pte));
+      *pte = 0;
+
+      /* Drop any stale TLB entry.  See [IA32-v3a] 3.12
+         "Translation Lookaside Buffers (TLBs)". */
+      asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+    }
+}
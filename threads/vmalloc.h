@@ -0,0 +1,37 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Virtually contiguous kernel allocations.
+
+   Kernel virtual addresses from VMALLOC_START to VMALLOC_END are
+   set aside for allocations of several pages that need only be
+   contiguous in virtual memory.  Each page is obtained
+   separately from the kernel pool and mapped into this region
+   through init_page_dir, so a large allocation can succeed even
+   when free physical memory is too fragmented for
+   palloc_get_multiple().  The region lies well above the direct
+   mapping of physical memory, which the loader caps at 64 MB. */
+#define VMALLOC_START ((uint8_t *) PHYS_BASE + 0x10000000)
+#define VMALLOC_PAGES 4096      /* 16 MB. */
+#define VMALLOC_END (VMALLOC_START + VMALLOC_PAGES * PGSIZE)
+
+/* Returns true if VADDR lies in the vmalloc region. */
+static inline bool
+is_vmalloc_vaddr (const void *vaddr)
+{
+  return (const uint8_t *) vaddr >= VMALLOC_START
+          && (const uint8_t *) vaddr < VMALLOC_END;
+}
+
+void vmalloc_init (void);
+void *vmalloc (enum palloc_flags, size_t page_cnt);
+void vfree (void *, size_t page_cnt);
+void vmalloc_print_stats (void);
+
+#endif /* threads/vmalloc.h */
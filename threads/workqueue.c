@@ -0,0 +1,184 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* A queue of work items of one class. */
+struct workqueue
+  {
+    const char *name;           /* Name, also used for the worker. */
+    int priority;               /* Worker thread priority. */
+    struct list items;          /* Pending work items. */
+    struct semaphore item_cnt;  /* Number of pending items. */
+
+    /* Statistics. */
+    unsigned long long queue_cnt;       /* Items queued. */
+    unsigned long long run_cnt;         /* Items run. */
+    unsigned depth;                     /* Items pending now. */
+    unsigned max_depth;                 /* Most items ever pending. */
+    int64_t latency;                    /* Total queue-to-start time. */
+    int64_t max_latency;                /* Longest queue-to-start time. */
+  };
+
+static struct workqueue queues[WORK_CLASS_CNT] =
+  {
+    [WORK_HIGH] = { .name = "work-high", .priority = PRI_MAX },
+    [WORK_NORMAL] = { .name = "work-normal", .priority = PRI_DEFAULT + 1 },
+    [WORK_LOW] = { .name = "work-low", .priority = PRI_MIN },
+  };
+
+static thread_func worker;
+
+/* Initializes the work queues.  Work may be queued from then on,
+   but it will not run until workqueue_start() is called. */
+void
+workqueue_init (void)
+{
+  struct workqueue *q;
+
+  for (q = queues; q < queues + WORK_CLASS_CNT; q++)
+    {
+      list_init (&q->items);
+      sema_init (&q->item_cnt, 0);
+    }
+}
+
+/* Starts a worker thread for each work queue.  Must be called
+   after thread_start(). */
+void
+workqueue_start (void)
+{
+  struct workqueue *q;
+
+  for (q = queues; q < queues + WORK_CLASS_CNT; q++)
+    if (thread_create (q->name, q->priority, worker, q) == TID_ERROR)
+      PANIC ("%s: cannot start worker thread", q->name);
+}
+
+/* Prints work queue statistics. */
+void
+workqueue_print_stats (void)
+{
+  struct workqueue *q;
+
+  for (q = queues; q < queues + WORK_CLASS_CNT; q++)
+    if (q->queue_cnt > 0)
+      printf ("Work queue %s: %llu queued, %llu run, max depth %u, "
+              "%lld us avg latency (max %lld us)\n",
+              q->name, q->queue_cnt, q->run_cnt, q->max_depth,
+              timer_cycles_to_us (q->run_cnt > 0 ? q->latency / q->run_cnt : 0),
+              timer_cycles_to_us (q->max_latency));
+}
+
+/* Initializes work item W to run FUNC with AUX. */
+void
+work_init (struct work *w, work_func *func, void *aux)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/* Queues work item W on the queue for CLASS.  Returns true if
+   successful, false if W was already pending, in which case it
+   will run only once.  W may be queued again as soon as its
+   function has started.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue (struct work *w, enum work_class class)
+{
+  struct workqueue *q;
+  enum intr_level old_level;
+
+  ASSERT (w != NULL);
+  ASSERT (class < WORK_CLASS_CNT);
+
+  q = &queues[class];
+  old_level = intr_disable ();
+  if (w->pending)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  w->pending = true;
+  w->queue_time = timer_cycles ();
+  w->class = class;
+  list_push_back (&q->items, &w->elem);
+  q->queue_cnt++;
+  if (++q->depth > q->max_depth)
+    q->max_depth = q->depth;
+  sema_up (&q->item_cnt);
+  intr_set_level (old_level);
+
+  /* Let the worker run right away if it outranks us. */
+  if (old_level == INTR_ON)
+    thread_preempt ();
+  return true;
+}
+
+/* Removes work item W from its queue if it has not started yet.
+   Returns true if W was removed, false if it was not pending.
+   Does not wait for a W that is already running.
+
+   This function may be called from an interrupt handler. */
+bool
+work_cancel (struct work *w)
+{
+  struct workqueue *q;
+  enum intr_level old_level;
+  bool pending;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  pending = w->pending;
+  if (pending)
+    {
+      q = &queues[w->class];
+      list_remove (&w->elem);
+      w->pending = false;
+      q->depth--;
+      if (!sema_try_down (&q->item_cnt))
+        NOT_REACHED ();
+    }
+  intr_set_level (old_level);
+  return pending;
+}
+
+/* Worker thread for work queue Q_.  Runs queued work items, in
+   the order queued, with interrupts on. */
+static void
+worker (void *q_)
+{
+  struct workqueue *q = q_;
+
+  for (;;)
+    {
+      struct work *w;
+      enum intr_level old_level;
+      int64_t latency;
+
+      sema_down (&q->item_cnt);
+
+      old_level = intr_disable ();
+      ASSERT (!list_empty (&q->items));
+      w = list_entry (list_pop_front (&q->items), struct work, elem);
+      w->pending = false;
+      q->depth--;
+      latency = timer_cycles () - w->queue_time;
+      q->latency += latency;
+      if (latency > q->max_latency)
+        q->max_latency = latency;
+      intr_set_level (old_level);
+
+      w->func (w->aux);
+      q->run_cnt++;
+    }
+}
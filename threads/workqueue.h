@@ -0,0 +1,49 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Deferred work.
+
+   An interrupt handler must do its work with interrupts off, so
+   it should do as little as it can: acknowledge the device, grab
+   the data, and queue a work item.  A kernel worker thread later
+   runs the item's function with interrupts on.  Kernel threads
+   may also queue work, to run jobs in the background. */
+
+/* Work queue classes, each served by its own worker thread at
+   its own priority. */
+enum work_class
+  {
+    WORK_HIGH,                  /* Latency-sensitive, e.g. input. */
+    WORK_NORMAL,                /* Ordinary deferred work. */
+    WORK_LOW,                   /* Background jobs, e.g. flushing. */
+    WORK_CLASS_CNT              /* Number of classes. */
+  };
+
+/* Function run by a worker thread for a work item. */
+typedef void work_func (void *aux);
+
+/* A work item.  The owner provides the storage, which must stay
+   valid while the item is queued. */
+struct work
+  {
+    struct list_elem elem;      /* Element in work queue. */
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Queued but not yet started? */
+    enum work_class class;      /* Class queued in, if pending. */
+    int64_t queue_time;         /* When queued, in PIT cycles. */
+  };
+
+void workqueue_init (void);
+void workqueue_start (void);
+void workqueue_print_stats (void);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct work *, enum work_class);
+bool work_cancel (struct work *);
+
+#endif /* threads/workqueue.h */
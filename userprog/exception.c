@@ -7,6 +7,9 @@
 #include "threads/thread.h"
 #include "userprog/pagedir.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -142,6 +145,22 @@ page_fault (struct intr_frame *f)
      [IA32-v3a] 5.15 "Interrupt 14--Page Fault Exception
      (#PF)". */
   asm ("movl %%cr2, %0" : "=r" (fault_addr));
+  thread_current ()->usage.page_faults++;
+
+#ifdef VM
+  /* Bring in a page of the process that has not been touched
+     yet.  The kernel may fault on such a page too, while it
+     accesses user memory on the process's behalf. */
+  if ((f->error_code & PF_P) == 0 && is_user_vaddr (fault_addr))
+    {
+      intr_enable ();
+      if (page_load (fault_addr))
+        {
+          page_fault_cnt++;
+          return;
+        }
+    }
+#endif
 
   if (fault_addr == NULL) {
       f->eax = -1;
@@ -19,6 +19,9 @@
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 #define DEFAULT_NUMARGS 4 
 #define DELIMITER " "
@@ -74,6 +77,7 @@ static void start_process (void *file_name_) {
     } else {
         cur->c->load_status = 1;
     }
+    sema_up(&cur->c->load_done);
 
     /* free the file_name string, this copy is just used for starting the process */
     palloc_free_page (file_name);
@@ -96,39 +100,28 @@ static void start_process (void *file_name_) {
    exception), returns -1.  If TID is invalid or if it was not a
    child of the calling process, or if process_wait() has already
    been successfully called for the given TID, returns -1
-   immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
-int process_wait (tid_t child_tid UNUSED) {
+   immediately, without waiting.  Blocks, rather than spins, until
+   the child exits. */
+int process_wait (tid_t child_tid) {
 
     struct thread* cur=thread_current(); /*current parent thread*/
-    struct list_elem* CLE; /*child list element*/
-    struct child* c;  /*pointer to child with tid == child_tid*/
-
-    bool found = false;
-    for(CLE=list_begin(&(cur->child_list)); CLE != list_end(&(cur->child_list)); CLE=list_next(CLE)){
-        c = list_entry(CLE, struct child, elem); 
+    struct child* c = thread_get_child(child_tid); /*child with tid == child_tid*/
 
-        if(c->tid == child_tid){
-            found = true;
-            break;
-        }
-    }
-
-    /* if child_tid is not from a child process of parent */
-    if(!found) {
+    /* if child_tid is not from a child process of parent, or was already waited for */
+    if(c == NULL || c->waited) {
         return -1; 
     }
     
-    while(!c->exiting){
-        barrier();
-    }
+    /* block until the child has exited */
+    sema_down(&c->exit_done);
     int status = c->exit_status;
 
-    /*destroy child object for exited thread*/
-    list_remove(CLE);
-    free(c);
+    /* charge the child's resource usage to the parent */
+    rusage_add(&cur->children_usage, &c->usage);
+
+    /* keep the child object, so that rusage() can still report on
+       the child; it is released when the parent exits */
+    c->waited = true;
     
     return status;
 }
@@ -159,7 +152,14 @@ void process_exit (void) {
 /*#####*/
 
 
-  cur->c->exiting = true;
+
+#ifdef VM
+  if (cur->pages_init)
+    {
+      page_table_destroy (&cur->pages);
+      cur->pages_init = false;
+    }
+#endif
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -284,6 +284,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_init (&t->pages))
+    goto done;
+  t->pages_init = true;
+#endif
 
   
   /* Get filename without arguments */
@@ -391,7 +396,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -450,6 +457,10 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only recorded in the
+   supplemental page table here, and are read in by the page
+   fault handler when the process first touches them.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -469,6 +480,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from. */
+      if (!page_add (upage, page_read_bytes > 0 ? file : NULL, ofs,
+                     page_read_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -488,6 +506,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -498,12 +517,19 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory.  With VM the page is only recorded in the
+   supplemental page table, so that it can be evicted like any other. */
 static bool setup_stack (void **esp, const char* file_name) {
-    uint8_t *kpage;
     bool success = false;
 
-    kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+#ifdef VM
+    /* the stack page is zero-filled when the args below are first written to it */
+    success = page_add (((uint8_t *) PHYS_BASE) - PGSIZE, NULL, 0, 0, true);
+    if (success) {
+        *esp = PHYS_BASE;
+    }
+#else
+    uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
     if (kpage != NULL){ 
         success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
         if (success) {
@@ -512,6 +538,7 @@ static bool setup_stack (void **esp, const char* file_name) {
             palloc_free_page (kpage);
         }
     }
+#endif
     //printf("setting up the stack with filename = %s\n", file_name);
     
     char **args = malloc(DEFAULT_NUMARGS*sizeof(char*));
@@ -525,8 +552,10 @@ static bool setup_stack (void **esp, const char* file_name) {
         i++;
         
         if (i>=size) {
+            /* grow both arrays; realloc extends them in place when it can */
             size *= 2;
             args = realloc(args, size*sizeof(char*));
+            arg_addrs = realloc(arg_addrs, size*sizeof(char*));
         }
         arg = strtok_r(NULL, DELIMITER, &saveptr);
     }
@@ -572,6 +601,7 @@ static bool setup_stack (void **esp, const char* file_name) {
     return success;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -591,3 +621,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
@@ -1,24 +1,38 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include <user/syscall.h>
 #include "devices/input.h"
 #include "devices/shutdown.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 struct lock write_lock;
+static struct kmem_cache *filehandle_cache; /* cache of struct filehandle */
 static void syscall_handler (struct intr_frame *);
 void get_arg (struct intr_frame *f, int *arg, int n);
 void is_valid_ptr(const void *ptr); 
 void is_valid_buf(void *buf, int len);
+static void *user_to_kernel(const void *uaddr, bool write);
+static void release_user(const void *uaddr);
+static void pin_user_buf(const void *ubuf, unsigned size, bool write);
+static void unpin_user_buf(const void *ubuf, unsigned size);
+static void *user_kaddr(const void *uaddr);
+static unsigned user_chunk(const void *uaddr, unsigned size);
+static char *copy_in_string(const char *us);
+static void copy_out(void *udst, const void *src, unsigned size);
 int write(int fd, const void *buffer, unsigned size);
 void is_valid_buf(void *buf, int len);
 void is_valid_ptr(const void *ptr);
@@ -35,10 +49,12 @@ int read(int fd, void *buffer, unsigned size);
 void seek(int fd, unsigned position);
 unsigned tell(int fd);
 void close(int fd);
+bool rusage(pid_t pid, struct rusage *usage);
 
 void syscall_init (void) {
     intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-    lock_init(&write_lock);
+    lock_init_named(&write_lock, "syscall write");
+    filehandle_cache = kmem_cache_create("filehandle", sizeof(struct filehandle), NULL);
 }
 
 static void syscall_handler (struct intr_frame *f UNUSED) {
@@ -60,11 +76,13 @@ static void syscall_handler (struct intr_frame *f UNUSED) {
             break;
         } case SYS_EXEC: {
             is_valid_ptr((const void *) arg[0]);
-            const char* buf = pagedir_get_page(thread_current()->pagedir, (const void *)arg[0]);
-            if (buf == NULL) {
-                exit(-1);
+            char* cmd_line = copy_in_string((const char *)arg[0]);
+            if (cmd_line == NULL) {
+                f->eax = -1;
+                break;
             }
-            f->eax = exec(buf);
+            f->eax = exec(cmd_line);
+            palloc_free_page(cmd_line);
             break;
         } case SYS_WAIT: {
             f->eax = process_wait(arg[0]);
@@ -86,19 +104,15 @@ static void syscall_handler (struct intr_frame *f UNUSED) {
             break;
         } case SYS_READ: {
             is_valid_buf((void *) arg[1], arg[2]);
-            void* buf = pagedir_get_page(thread_current()->pagedir, (const void *)arg[1]);
-            if (buf == NULL) {
-                exit(-1);
-            }
-            f->eax = read(arg[0], buf, (unsigned) arg[2]);
+            pin_user_buf((void *) arg[1], (unsigned) arg[2], true);
+            f->eax = read(arg[0], (void *) arg[1], (unsigned) arg[2]);
+            unpin_user_buf((void *) arg[1], (unsigned) arg[2]);
             break;
         } case SYS_WRITE: {
             is_valid_buf((void *) arg[1], arg[2]);
-            const void* buf = pagedir_get_page(thread_current()->pagedir, (const void *)arg[1]);
-            if (buf == NULL) {
-                exit(-1);
-            }
-            f->eax = write(arg[0], buf, (unsigned) arg[2]);
+            pin_user_buf((void *) arg[1], (unsigned) arg[2], false);
+            f->eax = write(arg[0], (const void *) arg[1], (unsigned) arg[2]);
+            unpin_user_buf((void *) arg[1], (unsigned) arg[2]);
             break;
         } case SYS_SEEK: {
                 seek(arg[0],arg[1]);
@@ -109,6 +123,14 @@ static void syscall_handler (struct intr_frame *f UNUSED) {
         } case SYS_CLOSE: {
             close((int)arg[0]);
             break;
+        } case SYS_RUSAGE: {
+            is_valid_buf((void *) arg[1], sizeof(struct rusage));
+            struct rusage usage;
+            f->eax = rusage(arg[0], &usage);
+            if (f->eax) {
+                copy_out((void *)arg[1], &usage, sizeof usage);
+            }
+            break;
         }
 	
     }
@@ -135,6 +157,126 @@ void is_valid_buf(void *buf, int len) {
     }
 }
 
+/* translate user address UADDR to the kernel address it is mapped at, or NULL if
+   it is not mapped. with VM the page is loaded if needed and pinned so it can't be
+   evicted while we use the kernel address (WRITE says whether we'll write to it);
+   call release_user() when done */
+static void *user_to_kernel(const void *uaddr, bool write UNUSED) {
+#ifdef VM
+    return page_pin(uaddr, write);
+#else
+    return pagedir_get_page(thread_current()->pagedir, uaddr);
+#endif
+}
+
+/* undo user_to_kernel() */
+static void release_user(const void *uaddr UNUSED) {
+#ifdef VM
+    page_unpin(uaddr);
+#endif
+}
+
+/* make sure every page of the SIZE-byte user buffer UBUF is mapped, and pin
+   them all with user_to_kernel() so that none of them can be evicted while the
+   kernel reads or writes the buffer through user_kaddr(). exits the process if
+   part of the buffer is not mapped. call unpin_user_buf() when done */
+static void pin_user_buf(const void *ubuf, unsigned size, bool write) {
+    const uint8_t *upage = pg_round_down(ubuf);
+    const uint8_t *end = (const uint8_t *) ubuf + size;
+
+    if (size == 0) {
+        return;
+    }
+    for (; upage < end; upage += PGSIZE) {
+        if (user_to_kernel(upage, write) == NULL) {
+            /* unpin the pages before this one */
+            if (upage > (const uint8_t *) ubuf) {
+                unpin_user_buf(ubuf, upage - (const uint8_t *) ubuf);
+            }
+            exit(-1);
+        }
+    }
+}
+
+/* undo pin_user_buf() */
+static void unpin_user_buf(const void *ubuf, unsigned size) {
+    const uint8_t *upage = pg_round_down(ubuf);
+    const uint8_t *end = (const uint8_t *) ubuf + size;
+
+    if (size == 0) {
+        return;
+    }
+    for (; upage < end; upage += PGSIZE) {
+        release_user(upage);
+    }
+}
+
+/* kernel address of UADDR, which must be in a buffer pinned with pin_user_buf() */
+static void *user_kaddr(const void *uaddr) {
+    return pagedir_get_page(thread_current()->pagedir, uaddr);
+}
+
+/* number of bytes of the SIZE bytes at user address UADDR that lie in the same
+   page as UADDR, i.e. how much can be accessed at once through user_kaddr() */
+static unsigned user_chunk(const void *uaddr, unsigned size) {
+    unsigned left = PGSIZE - pg_ofs(uaddr);
+    return size < left ? size : left;
+}
+
+/* copy the string at user address US into a new page allocated with
+   palloc_get_page(), truncating it to fit, and return the page, or NULL if
+   memory is short. the string is read a page at a time through
+   user_to_kernel(), since it may run onto a page that is not loaded yet.
+   exits the process if part of it is not mapped */
+static char *copy_in_string(const char *us) {
+    char *ks = palloc_get_page(0);
+    unsigned len = 0;
+
+    if (ks == NULL) {
+        return NULL;
+    }
+    for (;;) {
+        const char *upos = us + len;
+        const char *kpos;
+        unsigned chunk, i;
+
+        if (!is_user_vaddr(upos) || (kpos = user_to_kernel(upos, false)) == NULL) {
+            palloc_free_page(ks);
+            exit(-1);
+        }
+        chunk = user_chunk(upos, PGSIZE - 1 - len);
+        for (i = 0; i < chunk && kpos[i] != '\0'; i++) {
+            ks[len + i] = kpos[i];
+        }
+        release_user(upos);
+        len += i;
+        if (i < chunk || len == PGSIZE - 1) {
+            break;
+        }
+    }
+    ks[len] = '\0';
+    return ks;
+}
+
+/* copy SIZE bytes from kernel address SRC to user address UDST a page at a
+   time, through user_to_kernel(). the caller must have checked UDST with
+   is_valid_buf(); exits the process if part of it is not mapped */
+static void copy_out(void *udst, const void *src, unsigned size) {
+    uint8_t *ubuf = udst;
+    const uint8_t *kbuf = src;
+    unsigned done, chunk;
+
+    for (done = 0; done < size; done += chunk) {
+        void *kpos = user_to_kernel(ubuf + done, true);
+        if (kpos == NULL) {
+            exit(-1);
+        }
+        chunk = user_chunk(ubuf + done, size - done);
+        memcpy(kpos, kbuf + done, chunk);
+        release_user(ubuf + done);
+    }
+}
+
 /* get arguments for the system call off of the stack */
 void get_arg (struct intr_frame *f, int *arg, int n){
     int i;
@@ -146,10 +288,19 @@ void get_arg (struct intr_frame *f, int *arg, int n){
 }
 
 
+/* BUFFER is a user address, pinned with pin_user_buf(). it is written a page
+   at a time, since consecutive user pages need not be consecutive in the
+   kernel's address space */
 int write(int fd, const void *buffer, unsigned size) {
+    const uint8_t *ubuf = buffer;
+    unsigned done, chunk;
+
     /* TODO: synchronization */
     if (fd == STDOUT_FILENO) {
-        putbuf(buffer, size);
+        for (done = 0; done < size; done += chunk) {
+            chunk = user_chunk(ubuf + done, size - done);
+            putbuf(user_kaddr(ubuf + done), chunk);
+        }
         return size;
     } else if(fd == STDIN_FILENO) {
         return -1;
@@ -169,9 +320,16 @@ int write(int fd, const void *buffer, unsigned size) {
             return -1;
         }
         lock_acquire(&write_lock);/* NOTE: replace with lock from specific filesystem sector being written to, currently unsure about the granularity of the locking on the filesystem but I know this current implementation is not robust enough*/
-        unsigned int ret = file_write(fh->fp,buffer,size);
+        for (done = 0; done < size; done += chunk) {
+            chunk = user_chunk(ubuf + done, size - done);
+            unsigned int ret = file_write(fh->fp, user_kaddr(ubuf + done), chunk);
+            if (ret < chunk) {
+                done += ret;
+                break;
+            }
+        }
         lock_release(&write_lock);
-        return ret;
+        return done;
     }
 }
 
@@ -201,28 +359,15 @@ to ensure this.*/
     /* execute the command and return the new process's pid */ 
     pid_t pid = process_execute(cmd_line);
 
-    struct thread* cur=thread_current(); /*current parent thread*/
-    struct list_elem* CLE; /*child list element*/
-    struct child* c;  /*pointer to child with tid == child_tid*/
-
-    bool found = false;
-    for(CLE=list_begin(&(cur->child_list)); CLE != list_end(&(cur->child_list)); CLE=list_next(CLE)){
-        c = list_entry(CLE, struct child, elem); 
+    struct child* c = thread_get_child(pid); /*child with tid == pid*/
 
-        if(c->tid == pid){
-            found = true;
-            break;
-        }
-    }
-
-    /* if pid is not in the parent's child_list for some reason */
-    if(!found) {
+    /* if pid is not one of the parent's children for some reason */
+    if(c == NULL) {
         return -1; 
     }
    
-    while(!c->load_status){
-        barrier();
-    }
+    /* block until the child has tried to load its executable */
+    sema_down(&c->load_done);
     /* if load status = -1 then load of executable failed */
     if (c->load_status < 0) {
         return c->load_status;
@@ -256,7 +401,11 @@ int open(const char* file){
 	if(fd_p==NULL){
 	    return -1;
 	} else {
-        struct filehandle* new_fh=malloc(sizeof(struct child));
+        struct filehandle* new_fh=kmem_cache_alloc(filehandle_cache);
+        if(new_fh==NULL){
+            file_close(fd_p);
+            return -1;
+        }
         new_fh->fp=fd_p;
         new_fh->fd=cur->fd_count;/*accounting for STDIN and STDOUT*/
         list_push_back(&cur->fd_list,&new_fh->elem);
@@ -285,14 +434,20 @@ int filesize(int fd){
 	return ret;
 }
 
+/* BUFFER is a user address, pinned with pin_user_buf(). like write(), it is
+   filled a page at a time */
 int read(int fd, void *buffer, unsigned size){
-    unsigned int i;
+    uint8_t *ubuf = buffer;
+    unsigned int i, done, chunk;
 	if(fd == 0){
 	    /*Reading from keyboard (STDIN) using input_getc()*/
 	    /*TO-DO*/
-        uint8_t *tmp_buf = (uint8_t *) buffer;
-        for (i=0; i<size; i++) {
-            tmp_buf[i] = input_getc();
+        for (done = 0; done < size; done += chunk) {
+            chunk = user_chunk(ubuf + done, size - done);
+            uint8_t *tmp_buf = user_kaddr(ubuf + done);
+            for (i=0; i<chunk; i++) {
+                tmp_buf[i] = input_getc();
+            }
         }
 	    return size;
 	}
@@ -316,8 +471,15 @@ int read(int fd, void *buffer, unsigned size){
         return -1;
     }
     
-	unsigned ret=file_read(fh->fp,buffer,size);
-	return ret;
+    for (done = 0; done < size; done += chunk) {
+        chunk = user_chunk(ubuf + done, size - done);
+        unsigned ret=file_read(fh->fp, user_kaddr(ubuf + done), chunk);
+        if (ret < chunk) {
+            done += ret;
+            break;
+        }
+    }
+	return done;
 }
 
 void seek(int fd, unsigned position){
@@ -384,7 +546,28 @@ void close(int fd){
     
 	file_close(fh->fp);
     list_remove(e);
-    free(fh);
+    kmem_cache_free(filehandle_cache, fh);
 }
 
+bool rusage(pid_t pid, struct rusage *usage){
+/*Stores resource usage into USAGE: the calling process's own if pid is
+RUSAGE_SELF, the total of its waited-for children if pid is
+RUSAGE_CHILDREN, otherwise that of the child process pid, which must
+have exited, whether or not it has been waited for. Returns false if
+pid is none of these.*/
+    struct thread* cur=thread_current();
+    if (pid == RUSAGE_SELF) {
+        thread_get_rusage(usage);
+        return true;
+    } else if (pid == RUSAGE_CHILDREN) {
+        *usage = cur->children_usage;
+        return true;
+    }
 
+    struct child* c = thread_get_child(pid);
+    if(c != NULL && c->exiting){
+        *usage = c->usage;
+        return true;
+    }
+    return false;
+}
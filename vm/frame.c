@@ -0,0 +1,301 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.
+
+   Every page of physical memory that holds a page of a user
+   process is recorded here, in a single list that the "clock"
+   hand sweeps around.  When palloc has no free user page, the
+   hand looks for a frame whose page has not been accessed since
+   the hand last passed, clearing accessed bits as it goes
+   ("second chance").  The page in that frame is unmapped and,
+   if it was modified, written to swap; otherwise it can be read
+   back from its file or recreated as zeroes.  The frame is then
+   reused.
+
+   A frame is pinned while its page is being read in and while
+   the kernel accesses it through its kernel address, and pinned
+   frames are never evicted.  frame_lock protects the table and
+   the `frame' and `swap_slot' members of every page that has, or
+   is losing, a frame.
+
+   frame_lock is not held while an evicted page is written to
+   swap, so that other page faults need not wait for the disk.
+   Instead, the victim is unmapped and a swap slot reserved for
+   it with the lock held, and the frame is marked as `evicting'
+   until the write is done.  Its page keeps pointing to it until
+   then, and anyone who needs that page waits on `evicted'. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address of the page. */
+    struct page *page;          /* User page held. */
+    struct thread *owner;       /* Process that PAGE belongs to. */
+    bool pinned;                /* Exempt from eviction? */
+    bool evicting;              /* Page being written to swap? */
+    struct list_elem elem;      /* Element in `frames'. */
+  };
+
+/* All frames, in clock order. */
+static struct list frames;
+static size_t frame_cnt;
+
+/* Clock hand: the next frame to consider for eviction, or the
+   end of `frames' to start over from the beginning. */
+static struct list_elem *hand;
+
+/* Protects the frame table. */
+static struct lock frame_lock;
+
+/* Signaled, with frame_lock, when an eviction finishes. */
+static struct condition evicted;
+
+/* Cache of struct frame. */
+static struct kmem_cache *frame_cache;
+
+/* Statistics, protected by frame_lock. */
+static unsigned long long evict_cnt;    /* Pages evicted. */
+static unsigned long long dirty_cnt;    /* Evicted pages saved to swap. */
+static unsigned long long fail_cnt;     /* Failed calls to frame_alloc(). */
+
+static struct frame *evict (void);
+static bool page_out (struct frame *, size_t *slot);
+static void wait_evicted (struct page *);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  lock_init_named (&frame_lock, "frame table");
+  cond_init (&evicted);
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+}
+
+/* Obtains a frame for page P of the current process and returns
+   its kernel virtual address, evicting another page if there is
+   no free memory.  The frame is zeroed if ZERO is true.  Returns
+   a null pointer if no frame can be had.
+
+   The frame is returned pinned.  The caller should fill it, map
+   it, and then call frame_unpin(), or give it back with
+   frame_free() if that fails. */
+void *
+frame_alloc (struct page *p, bool zero)
+{
+  void *kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  struct frame *f = NULL;
+  bool reused = false;
+
+  lock_acquire (&frame_lock);
+  wait_evicted (p);
+  ASSERT (p->frame == NULL);
+  if (kpage != NULL)
+    {
+      f = kmem_cache_alloc (frame_cache);
+      if (f != NULL)
+        {
+          f->kpage = kpage;
+          f->evicting = false;
+          list_push_back (&frames, &f->elem);
+          frame_cnt++;
+        }
+      else
+        palloc_free_page (kpage);
+    }
+  else
+    {
+      f = evict ();
+      reused = true;
+    }
+
+  if (f != NULL)
+    {
+      f->page = p;
+      f->owner = thread_current ();
+      f->pinned = true;
+      p->frame = f;
+    }
+  else
+    fail_cnt++;
+  lock_release (&frame_lock);
+
+  if (f == NULL)
+    return NULL;
+  if (reused && zero)
+    memset (f->kpage, 0, PGSIZE);
+  return f->kpage;
+}
+
+/* Pins the frame that holds page P, if any, so that it will not
+   be evicted.  Returns true if P has a frame, false otherwise. */
+bool
+frame_pin (struct page *p)
+{
+  bool has_frame;
+
+  lock_acquire (&frame_lock);
+  wait_evicted (p);
+  has_frame = p->frame != NULL;
+  if (has_frame)
+    p->frame->pinned = true;
+  lock_release (&frame_lock);
+
+  return has_frame;
+}
+
+/* Unpins the frame that holds page P. */
+void
+frame_unpin (struct page *p)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (p->frame != NULL);
+  p->frame->pinned = false;
+  lock_release (&frame_lock);
+}
+
+/* Unmaps page P of the current process, if it is in memory, and
+   frees its frame.  If P is being evicted by another process,
+   waits for that to finish first, so that afterward P is
+   either in swap or nowhere. */
+void
+frame_free (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  wait_evicted (p);
+  f = p->frame;
+  if (f != NULL)
+    {
+      ASSERT (f->owner == thread_current ());
+      if (hand == &f->elem)
+        hand = list_next (hand);
+      list_remove (&f->elem);
+      frame_cnt--;
+      pagedir_clear_page (f->owner->pagedir, p->upage);
+      palloc_free_page (f->kpage);
+      kmem_cache_free (frame_cache, f);
+      p->frame = NULL;
+    }
+  lock_release (&frame_lock);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu in use, %llu evicted (%llu to swap), "
+          "%llu allocations failed\n",
+          frame_cnt, evict_cnt, dirty_cnt, fail_cnt);
+}
+
+/* Waits until page P is not being evicted.  Must be called with
+   frame_lock held. */
+static void
+wait_evicted (struct page *p)
+{
+  while (p->frame != NULL && p->frame->evicting)
+    cond_wait (&evicted, &frame_lock);
+}
+
+/* Chooses a frame with the clock algorithm, evicts its page, and
+   returns the frame, or returns a null pointer if every frame is
+   pinned or holds a modified page with no swap space for it.
+   Must be called with frame_lock held, which it releases while
+   it writes the page to swap. */
+static struct frame *
+evict (void)
+{
+  size_t i;
+
+  /* Two trips around are enough: the first clears every
+     accessed bit that is set. */
+  for (i = 0; i < 2 * frame_cnt; i++)
+    {
+      struct frame *f;
+      uint32_t *pd;
+      size_t slot;
+
+      if (hand == list_end (&frames))
+        hand = list_begin (&frames);
+      f = list_entry (hand, struct frame, elem);
+      hand = list_next (hand);
+
+      if (f->pinned || f->evicting)
+        continue;
+      pd = f->owner->pagedir;
+      if (pagedir_is_accessed (pd, f->page->upage))
+        pagedir_set_accessed (pd, f->page->upage, false);
+      else if (page_out (f, &slot))
+        {
+          if (slot != SWAP_NONE)
+            {
+              f->evicting = true;
+              lock_release (&frame_lock);
+              swap_out (slot, f->kpage);
+              lock_acquire (&frame_lock);
+              f->evicting = false;
+              f->page->swap_slot = slot;
+              dirty_cnt++;
+            }
+          f->page->frame = NULL;
+          cond_broadcast (&evicted, &frame_lock);
+          evict_cnt++;
+          return f;
+        }
+    }
+  return NULL;
+}
+
+/* Removes the page in frame F from its owner's address space.
+   If it was modified, reserves a swap slot for it and stores the
+   slot in *SLOT, for the caller to write the page to; otherwise,
+   sets *SLOT to SWAP_NONE.  Returns true if successful, false if
+   the page had to be saved but there was no swap space, in which
+   case it is left in place.  Must be called with frame_lock
+   held. */
+static bool
+page_out (struct frame *f, size_t *slot)
+{
+  struct page *p = f->page;
+  uint32_t *pd = f->owner->pagedir;
+  enum intr_level old_level;
+  bool dirty;
+
+  /* Unmap the page before writing it out, so that the owner
+     cannot modify it behind our back.  Reading the dirty bit and
+     unmapping must be atomic for the same reason. */
+  old_level = intr_disable ();
+  dirty = pagedir_is_dirty (pd, p->upage);
+  pagedir_clear_page (pd, p->upage);
+  intr_set_level (old_level);
+
+  *slot = SWAP_NONE;
+  if (dirty)
+    {
+      *slot = swap_alloc ();
+      if (*slot == SWAP_NONE)
+        {
+          /* The page table for the page still exists, so mapping
+             it again cannot fail. */
+          if (!pagedir_set_page (pd, p->upage, f->kpage, p->writable))
+            NOT_REACHED ();
+          pagedir_set_dirty (pd, p->upage, true);
+          return false;
+        }
+    }
+  return true;
+}
@@ -0,0 +1,15 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <stdbool.h>
+
+struct page;
+
+void frame_init (void);
+void *frame_alloc (struct page *, bool zero);
+bool frame_pin (struct page *);
+void frame_unpin (struct page *);
+void frame_free (struct page *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,274 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Pages are loaded lazily.  load() in userprog/process.c only
+   records each page of each loadable segment here, and the page
+   fault handler calls page_load() the first time the process
+   touches one.  Entries stay in the table after their pages are
+   loaded, since a page may be evicted and loaded again later,
+   and are freed along with it when the process exits.  Frames
+   are obtained from the frame table in vm/frame.c. */
+
+/* Cache of struct page. */
+static struct kmem_cache *page_cache;
+
+/* Statistics.  Updated with interrupts off. */
+static unsigned long long file_loads;   /* Pages read from files. */
+static unsigned long long swap_loads;   /* Pages read from swap. */
+static unsigned long long zero_loads;   /* Pages zero-filled. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static struct page *page_lookup (struct hash *, const void *upage);
+static bool page_in (struct page *, bool pin);
+
+/* Initializes the supplemental page table module and the frame
+   table. */
+void
+page_init (void)
+{
+  page_cache = kmem_cache_create ("page", sizeof (struct page), NULL);
+  frame_init ();
+}
+
+/* Initializes PAGES as an empty supplemental page table.
+   Returns true if successful, false if memory allocation
+   fails. */
+bool
+page_table_init (struct hash *pages)
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Frees every entry in supplemental page table PAGES, which must
+   belong to the current process, along with the frames and swap
+   slots holding their pages, and then the table itself. */
+void
+page_table_destroy (struct hash *pages)
+{
+  hash_destroy (pages, page_destroy);
+}
+
+/* Records that the current process's page at UPAGE is to be
+   loaded on demand from READ_BYTES bytes of FILE starting at
+   offset OFS, with the rest of the page zeroed, and is writable
+   by the process if WRITABLE is true.  FILE may be null if
+   READ_BYTES is 0.  FILE must stay open until the process
+   exits.  Returns true if successful, false if UPAGE is already
+   in the table or memory allocation fails. */
+bool
+page_add (void *upage, struct file *file, off_t ofs, size_t read_bytes,
+          bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (read_bytes <= PGSIZE);
+  ASSERT (file != NULL || read_bytes == 0);
+
+  p = kmem_cache_alloc (page_cache);
+  if (p == NULL)
+    return false;
+  p->upage = upage;
+  p->writable = writable;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->frame = NULL;
+  p->swap_slot = SWAP_NONE;
+
+  if (hash_insert (&t->pages, &p->elem) != NULL)
+    {
+      kmem_cache_free (page_cache, p);
+      return false;
+    }
+  return true;
+}
+
+/* Loads the current process's page that contains UADDR, if it is
+   in the supplemental page table and not yet present.  Returns
+   true if the page is now present, false if UADDR is not part of
+   the process's address space or the page could not be loaded.
+   Must be called with interrupts on. */
+bool
+page_load (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  if (!t->pages_init)
+    return false;
+  p = page_lookup (&t->pages, pg_round_down (uaddr));
+  if (p == NULL)
+    return false;
+  if (pagedir_get_page (t->pagedir, p->upage) != NULL)
+    return true;
+  return page_in (p, false);
+}
+
+/* Loads the current process's page that contains UADDR, if
+   necessary, and pins it in memory, so that the kernel can
+   access it through its kernel virtual address without it being
+   evicted.  If WRITE is true, the page must be writable, and it
+   is marked dirty, since writes through the kernel address do
+   not set the user page's dirty bit.  Returns the kernel virtual
+   address for UADDR, or a null pointer if UADDR is not part of
+   the process's address space or the page could not be loaded.
+   If successful, the page must later be unpinned with
+   page_unpin(). */
+void *
+page_pin (const void *uaddr, bool write)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  if (!t->pages_init)
+    return NULL;
+  p = page_lookup (&t->pages, pg_round_down (uaddr));
+  if (p == NULL || (write && !p->writable))
+    return NULL;
+  if (!frame_pin (p) && !page_in (p, true))
+    return NULL;
+  if (write)
+    pagedir_set_dirty (t->pagedir, p->upage, true);
+  return pagedir_get_page (t->pagedir, uaddr);
+}
+
+/* Unpins the current process's page that contains UADDR, which
+   must have been pinned with page_pin(). */
+void
+page_unpin (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (&t->pages, pg_round_down (uaddr));
+
+  ASSERT (p != NULL);
+  frame_unpin (p);
+}
+
+/* Reads page P of the current process into a new frame and maps
+   it.  Leaves the frame pinned if PIN is true.  Returns true if
+   successful, false on failure. */
+static bool
+page_in (struct page *p, bool pin)
+{
+  struct thread *t = thread_current ();
+  bool zero = p->swap_slot == SWAP_NONE && p->read_bytes == 0;
+  bool from_swap = false;
+  uint8_t *kpage;
+  enum intr_level old_level;
+
+  /* If P is being evicted, this waits for that to finish, so
+     that swap_slot is up to date afterward. */
+  kpage = frame_alloc (p, zero);
+  if (kpage == NULL)
+    return false;
+
+  if (p->swap_slot != SWAP_NONE)
+    {
+      from_swap = true;
+      swap_in (p->swap_slot, kpage);
+      p->swap_slot = SWAP_NONE;
+    }
+  else if (p->read_bytes > 0)
+    {
+      if (file_read_at (p->file, kpage, p->read_bytes, p->ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_free (p);
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+  if (!pagedir_set_page (t->pagedir, p->upage, kpage, p->writable))
+    {
+      frame_free (p);
+      return false;
+    }
+
+  /* Memory now holds the only copy of a page read from swap, so
+     it must be saved again if it is evicted. */
+  if (from_swap)
+    pagedir_set_dirty (t->pagedir, p->upage, true);
+
+  old_level = intr_disable ();
+  if (from_swap)
+    swap_loads++;
+  else if (p->read_bytes > 0)
+    file_loads++;
+  else
+    zero_loads++;
+  intr_set_level (old_level);
+  if (!pin)
+    frame_unpin (p);
+  return true;
+}
+
+/* Prints demand paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %llu pages loaded from files, %llu from swap, "
+          "%llu zero-filled\n", file_loads, swap_loads, zero_loads);
+}
+
+/* Returns the entry for UPAGE in PAGES, or a null pointer if
+   there is none. */
+static struct page *
+page_lookup (struct hash *pages, const void *upage)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = (void *) upage;
+  e = hash_find (pages, &key.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Returns a hash value for page P_. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (p_, struct page, elem);
+  return hash_int ((uintptr_t) p->upage >> PGBITS);
+}
+
+/* Returns true if page A_ precedes page B_. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, elem);
+  const struct page *b = hash_entry (b_, struct page, elem);
+
+  return a->upage < b->upage;
+}
+
+/* Frees page P_, along with its frame or swap slot.  Used by
+   page_table_destroy(). */
+static void
+page_destroy (struct hash_elem *p_, void *aux UNUSED)
+{
+  struct page *p = hash_entry (p_, struct page, elem);
+
+  frame_free (p);
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  kmem_cache_free (page_cache, p);
+}
@@ -0,0 +1,46 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct frame;
+
+/* Supplemental page table entry.
+
+   Each user process records here, for every page of its address
+   space, where the page's initial contents come from, so that
+   the page can be loaded when it is first touched instead of
+   when the process starts, and where the page is now: in a
+   frame, in a swap slot, or neither, if it has never been
+   modified. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct hash_elem elem;      /* Element in thread's `pages'. */
+    bool writable;              /* Writable by the process? */
+
+    /* Initial contents: READ_BYTES bytes read from FILE at offset
+       OFS, followed by zeroes.  FILE is null if READ_BYTES is 0. */
+    struct file *file;          /* File to read from. */
+    off_t ofs;                  /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read from FILE. */
+
+    /* Current location.  See vm/frame.c for synchronization. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    size_t swap_slot;           /* Swap slot holding it, or SWAP_NONE. */
+  };
+
+void page_init (void);
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+bool page_add (void *upage, struct file *, off_t ofs, size_t read_bytes,
+               bool writable);
+bool page_load (const void *uaddr);
+void *page_pin (const void *uaddr, bool write);
+void page_unpin (const void *uaddr);
+void page_print_stats (void);
+
+#endif /* vm/page.h */
@@ -0,0 +1,128 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The swap device is divided into page-sized slots of
+   SECTORS_PER_SLOT consecutive sectors.  A bitmap records which
+   slots are in use.  If there is no swap device, every swap_alloc()
+   fails, so only pages that can be reloaded from their files, or
+   that were never written, can be evicted. */
+
+/* Sectors in a slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Swap device and its slots, or null pointers if none. */
+static struct block *swap_device;
+static struct bitmap *used_slots;
+
+/* Protects used_slots and the statistics. */
+static struct lock swap_lock;
+
+/* Statistics. */
+static size_t used_cnt;                 /* Slots in use. */
+static size_t max_used;                 /* Most slots ever in use. */
+static unsigned long long out_cnt;      /* Pages written. */
+static unsigned long long in_cnt;       /* Pages read. */
+
+/* Finds the swap device and sets up its slots.  Must be called
+   after the block devices have been located. */
+void
+swap_init (void)
+{
+  lock_init_named (&swap_lock, "swap");
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    return;
+
+  used_slots = bitmap_create (block_size (swap_device) / SECTORS_PER_SLOT);
+  if (used_slots == NULL)
+    PANIC ("swap: failed to allocate slot bitmap");
+}
+
+/* Reserves a free swap slot and returns it, or returns SWAP_NONE
+   if there is none.  The slot should then be filled with
+   swap_out(). */
+size_t
+swap_alloc (void)
+{
+  size_t slot;
+
+  if (used_slots == NULL)
+    return SWAP_NONE;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip_next (used_slots, 1, false);
+  if (slot != BITMAP_ERROR && ++used_cnt > max_used)
+    max_used = used_cnt;
+  lock_release (&swap_lock);
+
+  return slot != BITMAP_ERROR ? slot : SWAP_NONE;
+}
+
+/* Writes the page at KPAGE to swap slot SLOT, which must have
+   been obtained from swap_alloc(). */
+void
+swap_out (size_t slot, const void *kpage)
+{
+  size_t i;
+
+  ASSERT (used_slots != NULL);
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_write (swap_device, slot * SECTORS_PER_SLOT + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&swap_lock);
+  out_cnt++;
+  lock_release (&swap_lock);
+}
+
+/* Reads swap slot SLOT into the page at KPAGE and frees the
+   slot. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  size_t i;
+
+  ASSERT (used_slots != NULL);
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_read (swap_device, slot * SECTORS_PER_SLOT + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&swap_lock);
+  in_cnt++;
+  lock_release (&swap_lock);
+  swap_free (slot);
+}
+
+/* Frees swap slot SLOT without reading it. */
+void
+swap_free (size_t slot)
+{
+  ASSERT (used_slots != NULL);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  bitmap_reset (used_slots, slot);
+  used_cnt--;
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  if (used_slots == NULL)
+    {
+      printf ("Swap: no swap device\n");
+      return;
+    }
+  printf ("Swap: %zu of %zu slots in use (max %zu), "
+          "%llu pages out, %llu in\n",
+          used_cnt, bitmap_size (used_slots), max_used, out_cnt, in_cnt);
+}
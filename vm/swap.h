@@ -0,0 +1,17 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A page-sized slot on the swap device. */
+#define SWAP_NONE SIZE_MAX      /* No slot. */
+
+void swap_init (void);
+size_t swap_alloc (void);
+void swap_out (size_t slot, const void *kpage);
+void swap_in (size_t slot, void *kpage);
+void swap_free (size_t slot);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */